@@ -0,0 +1,92 @@
+# The command line renderer, benchmark and soak test, see Source/RenderMain.cpp,
+# Source/BenchmarkMain.cpp and Source/SoakTestMain.cpp. They aren't in the Projucer project, so
+# they live here instead of in the generated Makefile, which this includes for its settings and
+# to link them against the same shared code library as the plugin:
+#
+#   make -f Tools.mk CONFIG=Release Render Benchmark
+#   make -f Tools.mk AUDIO_THREAD_CHECKS=1 SoakTest
+#
+# AUDIO_THREAD_CHECKS=1 builds everything with the allocation and lock checks in processBlock(),
+# see Source/AudioThreadChecker.h, and TRACE=1 with the trace recorder, see
+# Source/TraceRecorder.h. They can be combined, and the plugin itself can be built with them too,
+# for example "make -f Tools.mk TRACE=1 Standalone". Each combination has its own directories, so
+# nothing built with them gets mixed up with a normal build.
+
+ifndef CONFIG
+  CONFIG := Debug
+endif
+
+ifeq ($(AUDIO_THREAD_CHECKS),1)
+  override CPPFLAGS += -DBASICSYNTH_CHECK_AUDIO_THREAD=1
+  TOOLS_VARIANT := $(TOOLS_VARIANT)/Checked
+endif
+
+ifeq ($(TRACE),1)
+  override CPPFLAGS += -DBASICSYNTH_TRACE=1
+  TOOLS_VARIANT := $(TOOLS_VARIANT)/Traced
+endif
+
+# These have to be set before the Makefile's rules are read, and override its own settings
+ifneq ($(TOOLS_VARIANT),)
+  override JUCE_OBJDIR := build/intermediate/$(CONFIG)$(TOOLS_VARIANT)
+  override JUCE_OUTDIR := build$(TOOLS_VARIANT)
+  override JUCE_BINDIR := $(JUCE_OUTDIR)
+  override JUCE_LIBDIR := $(JUCE_OUTDIR)
+endif
+
+include Makefile
+
+.DEFAULT_GOAL := Tools
+
+JUCE_TARGET_RENDER := BasicSynthRender
+JUCE_TARGET_BENCHMARK := BasicSynthBenchmark
+JUCE_TARGET_SOAKTEST := BasicSynthSoakTest
+JUCE_LDFLAGS_SOAKTEST := -rdynamic
+
+OBJECTS_RENDER := \
+  $(JUCE_OBJDIR)/Tools/RenderMain.o \
+
+OBJECTS_BENCHMARK := \
+  $(JUCE_OBJDIR)/Tools/BenchmarkMain.o \
+  $(JUCE_OBJDIR)/Tools/AllocationCounter.o \
+  $(JUCE_OBJDIR)/Tools/AudioThreadChecker.o \
+
+OBJECTS_SOAKTEST := \
+  $(JUCE_OBJDIR)/Tools/SoakTestMain.o \
+  $(JUCE_OBJDIR)/Tools/AllocationCounter.o \
+  $(JUCE_OBJDIR)/Tools/AudioThreadChecker.o \
+
+.PHONY: Tools Render Benchmark SoakTest
+
+Tools : Render Benchmark
+
+Render : $(JUCE_OUTDIR)/$(JUCE_TARGET_RENDER)
+Benchmark : $(JUCE_OUTDIR)/$(JUCE_TARGET_BENCHMARK)
+
+# The soak test only checks anything with AUDIO_THREAD_CHECKS=1, so it isn't built by default
+SoakTest : $(JUCE_OUTDIR)/$(JUCE_TARGET_SOAKTEST)
+
+$(JUCE_OUTDIR)/$(JUCE_TARGET_RENDER) : check-pkg-config $(OBJECTS_RENDER) $(RESOURCES) $(JUCE_OUTDIR)/$(JUCE_TARGET_SHARED_CODE)
+	@echo Linking "BasicSynth - Render"
+	-$(V_AT)mkdir -p $(JUCE_OUTDIR)
+	$(V_AT)$(CXX) -o $@ $(OBJECTS_RENDER) $(JUCE_OUTDIR)/$(JUCE_TARGET_SHARED_CODE) $(JUCE_LDFLAGS) $(RESOURCES) $(TARGET_ARCH)
+
+$(JUCE_OUTDIR)/$(JUCE_TARGET_BENCHMARK) : check-pkg-config $(OBJECTS_BENCHMARK) $(RESOURCES) $(JUCE_OUTDIR)/$(JUCE_TARGET_SHARED_CODE)
+	@echo Linking "BasicSynth - Benchmark"
+	-$(V_AT)mkdir -p $(JUCE_OUTDIR)
+	$(V_AT)$(CXX) -o $@ $(OBJECTS_BENCHMARK) $(JUCE_OUTDIR)/$(JUCE_TARGET_SHARED_CODE) $(JUCE_LDFLAGS) $(RESOURCES) $(TARGET_ARCH)
+
+$(JUCE_OUTDIR)/$(JUCE_TARGET_SOAKTEST) : check-pkg-config $(OBJECTS_SOAKTEST) $(RESOURCES) $(JUCE_OUTDIR)/$(JUCE_TARGET_SHARED_CODE)
+	@echo Linking "BasicSynth - SoakTest"
+	-$(V_AT)mkdir -p $(JUCE_OUTDIR)
+	$(V_AT)$(CXX) -o $@ $(OBJECTS_SOAKTEST) $(JUCE_OUTDIR)/$(JUCE_TARGET_SHARED_CODE) $(JUCE_LDFLAGS) $(JUCE_LDFLAGS_SOAKTEST) $(RESOURCES) $(TARGET_ARCH)
+
+# Compiled like the shared code, so they see the same JucePlugin_ settings as the library
+$(JUCE_OBJDIR)/Tools/%.o: ../../Source/%.cpp
+	-$(V_AT)mkdir -p $(JUCE_OBJDIR)/Tools
+	@echo "Compiling $(<F)"
+	$(V_AT)$(CXX) $(JUCE_CXXFLAGS) $(JUCE_CPPFLAGS_SHARED_CODE) $(JUCE_CFLAGS_SHARED_CODE) -o "$@" -c "$<"
+
+-include $(OBJECTS_RENDER:%.o=%.d)
+-include $(OBJECTS_BENCHMARK:%.o=%.d)
+-include $(OBJECTS_SOAKTEST:%.o=%.d)
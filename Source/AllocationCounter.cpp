@@ -0,0 +1,83 @@
+#include "AllocationCounter.h"
+#include "AudioThreadChecker.h"
+
+#if JUCE_LINUX
+
+// A thread_local of a plain type in the executable itself lives in static TLS, so reading it
+// never allocates, which would recurse
+static thread_local int64 numAllocations = 0;
+
+// Always inlined, so the hooks are the frame that AudioThreadChecker skips over
+static forcedinline void countAllocation(const char* function) noexcept
+{
+    ++numAllocations;
+
+    if (AudioThreadChecker::isAudioThread())
+        AudioThreadChecker::recordViolation(function);
+}
+
+extern "C"
+{
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void* __libc_memalign(size_t, size_t);
+    void __libc_free(void*);
+
+    void* malloc(size_t size)
+    {
+        countAllocation(__func__);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t numElements, size_t elementSize)
+    {
+        countAllocation(__func__);
+        return __libc_calloc(numElements, elementSize);
+    }
+
+    // A realloc() that shrinks or grows in place still counts, as it may not next time
+    void* realloc(void* pointer, size_t size)
+    {
+        countAllocation(__func__);
+        return __libc_realloc(pointer, size);
+    }
+
+    void* memalign(size_t alignment, size_t size)
+    {
+        countAllocation(__func__);
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size)
+    {
+        countAllocation(__func__);
+        return __libc_memalign(alignment, size);
+    }
+
+    // Frees aren't counted, but are still reported on the audio thread
+    void free(void* pointer)
+    {
+        if (pointer != nullptr && AudioThreadChecker::isAudioThread())
+            AudioThreadChecker::recordViolation("free");
+
+        __libc_free(pointer);
+    }
+
+    int posix_memalign(void** result, size_t alignment, size_t size)
+    {
+        countAllocation(__func__);
+        *result = __libc_memalign(alignment, size);
+        return *result != nullptr || size == 0 ? 0 : ENOMEM;
+    }
+}
+
+bool AllocationCounter::isAvailable() noexcept     { return true; }
+int64 AllocationCounter::getThreadCount() noexcept { return numAllocations; }
+
+#else
+
+bool AllocationCounter::isAvailable() noexcept     { return false; }
+int64 AllocationCounter::getThreadCount() noexcept { return 0; }
+
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Counts the heap allocations made by the calling thread, so the benchmarks can check that
+// processBlock() doesn't allocate.
+//
+// The counting is done by AllocationCounter.cpp, which replaces malloc() and its relatives and
+// passes them on to glibc. Everything that allocates, operator new and JUCE's HeapBlock
+// included, ends up there. Only the command line tools link it, never the plugin, and it only
+// works on Linux: elsewhere isAvailable() is false and the count stays at 0. The same
+// functions report allocations made on the audio thread to AudioThreadChecker.
+struct AllocationCounter
+{
+    static bool isAvailable() noexcept;
+
+    // Allocations made by this thread since it started
+    static int64 getThreadCount() noexcept;
+};
@@ -0,0 +1,223 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "AudioThreadChecker.h"
+
+#include <ostream>
+
+#if JUCE_LINUX
+
+#include <execinfo.h>
+#include <cxxabi.h>
+#include <dlfcn.h>
+
+// Each distinct call stack is kept once, with a count. Anything past the last slot is only
+// counted.
+static constexpr int maxCallSites = 256;
+static constexpr int maxFrames = 24;
+
+struct CallSite
+{
+    const char* function;
+    void* frames[maxFrames];
+    int numFrames;
+    int64 count;
+};
+
+static CallSite callSites[maxCallSites];
+static int numCallSites = 0;
+static int64 numViolations = 0, numUnrecordedViolations = 0;
+
+// A SpinLock, because a CriticalSection would end up back in the hook
+static SpinLock callSitesLock;
+
+// Reading the stack can allocate, which would report itself
+static thread_local bool isRecording = false;
+
+// The real pthread_mutex_lock(), looked up the first time a mutex is locked. glibc no longer
+// exports an internal name for it that can be linked to, unlike __libc_malloc().
+using MutexLockFunction = int (*)(pthread_mutex_t*);
+static std::atomic<MutexLockFunction> realMutexLock { nullptr };
+
+static MutexLockFunction getRealMutexLock() noexcept
+{
+    auto function = realMutexLock.load(std::memory_order_relaxed);
+
+    if (function == nullptr)
+    {
+        function = (MutexLockFunction)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+        realMutexLock.store(function, std::memory_order_relaxed);
+    }
+
+    return function;
+}
+
+extern "C"
+{
+    int pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        if (AudioThreadChecker::isAudioThread())
+            AudioThreadChecker::recordViolation("pthread_mutex_lock");
+
+        return getRealMutexLock()(mutex);
+    }
+}
+
+void AudioThreadChecker::initialise()
+{
+    getRealMutexLock();
+
+    void* frames[maxFrames];
+    backtrace(frames, maxFrames);
+}
+
+void AudioThreadChecker::recordViolation(const char* function) noexcept
+{
+    if (isRecording)
+        return;
+
+    isRecording = true;
+
+    void* frames[maxFrames];
+
+    // The first two frames are this function and the hook
+    const auto numFrames = jmax(0, backtrace(frames, maxFrames) - 2);
+
+    {
+        const SpinLock::ScopedLockType sl(callSitesLock);
+        ++numViolations;
+
+        auto* site = callSites + numCallSites;
+
+        for (auto i = 0; i < numCallSites; ++i)
+        {
+            if (callSites[i].function == function && callSites[i].numFrames == numFrames
+                 && std::equal(frames + 2, frames + 2 + numFrames, callSites[i].frames))
+            {
+                site = callSites + i;
+                break;
+            }
+        }
+
+        if (site == callSites + numCallSites)
+        {
+            if (numCallSites < maxCallSites)
+            {
+                site->function = function;
+                site->numFrames = numFrames;
+                site->count = 0;
+                std::copy(frames + 2, frames + 2 + numFrames, site->frames);
+                ++numCallSites;
+            }
+            else
+            {
+                site = nullptr;
+                ++numUnrecordedViolations;
+            }
+        }
+
+        if (site != nullptr)
+            ++site->count;
+    }
+
+    isRecording = false;
+}
+
+int64 AudioThreadChecker::getNumViolations() noexcept
+{
+    const SpinLock::ScopedLockType sl(callSitesLock);
+    return numViolations;
+}
+
+// Turns "binary(_ZN4juce...+0x1c) [0x4f2a10]" into "juce::...+0x1c"
+static String getFrameName(const char* symbol)
+{
+    const auto text = String(symbol);
+    const auto name = text.fromFirstOccurrenceOf("(", false, false).upToFirstOccurrenceOf("+", false, false);
+
+    if (name.isEmpty())
+        return text;
+
+    auto status = 0;
+
+    if (auto* demangled = abi::__cxa_demangle(name.toRawUTF8(), nullptr, nullptr, &status))
+    {
+        const auto result = String(demangled) + text.fromFirstOccurrenceOf(name, false, false).upToFirstOccurrenceOf(")", false, false);
+        ::free(demangled);
+        return result;
+    }
+
+    return text;
+}
+
+int64 AudioThreadChecker::printReport(std::ostream& stream, const StringArray& allowed,
+                                      const StringArray& allowedLockers)
+{
+    int64 numNotAllowed = 0;
+
+    // Copied out, so the report doesn't hold the lock while it allocates
+    Array<CallSite> sites;
+    int64 unrecorded;
+
+    {
+        const SpinLock::ScopedLockType sl(callSitesLock);
+
+        for (auto i = 0; i < numCallSites; ++i)
+            sites.add(callSites[i]);
+
+        unrecorded = numUnrecordedViolations;
+    }
+
+    for (auto& site : sites)
+    {
+        StringArray names;
+
+        if (auto** symbols = backtrace_symbols(site.frames, site.numFrames))
+        {
+            for (auto i = 0; i < site.numFrames; ++i)
+                names.add(getFrameName(symbols[i]));
+
+            ::free(symbols);
+        }
+
+        auto isAllowed = false;
+
+        for (auto& entry : allowed)
+            for (auto& name : names)
+                isAllowed = isAllowed || name.contains(entry);
+
+        // The first frame is whatever called the hook
+        if (String(site.function) == "pthread_mutex_lock" && names.size() > 0)
+            for (auto& entry : allowedLockers)
+                isAllowed = isAllowed || names[0].contains(entry);
+
+        if (! isAllowed)
+            numNotAllowed += site.count;
+
+        stream << (isAllowed ? "Allowed: " : "Audio thread violation: ") << site.function << " called "
+               << site.count << (site.count == 1 ? " time" : " times") << std::endl;
+
+        for (auto& name : names)
+            stream << "    " << name << std::endl;
+    }
+
+    if (unrecorded > 0)
+    {
+        stream << "Audio thread violation: " << unrecorded << " more at call sites that weren't recorded" << std::endl;
+        numNotAllowed += unrecorded;
+    }
+
+    return numNotAllowed;
+}
+
+#else
+
+void AudioThreadChecker::initialise() {}
+void AudioThreadChecker::recordViolation(const char*) noexcept {}
+int64 AudioThreadChecker::getNumViolations() noexcept { return 0; }
+
+int64 AudioThreadChecker::printReport(std::ostream& stream, const StringArray&, const StringArray&)
+{
+    stream << "The audio thread can't be checked on this platform" << std::endl;
+    return 0;
+}
+
+#endif
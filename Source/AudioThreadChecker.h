@@ -0,0 +1,72 @@
+#pragma once
+
+// Builds with BASICSYNTH_CHECK_AUDIO_THREAD=1 mark the threads running processBlock() and the
+// render workers, see ScopedAudioThread. It is off by default.
+#ifndef BASICSYNTH_CHECK_AUDIO_THREAD
+ #define BASICSYNTH_CHECK_AUDIO_THREAD 0
+#endif
+
+// Catches heap allocations and mutex locks on the audio thread, for tests and soak runs.
+//
+// In a build with BASICSYNTH_CHECK_AUDIO_THREAD=1, processBlock() and the render workers mark
+// their thread as an audio thread for as long as they are rendering. The soak test links
+// AllocationCounter.cpp, which replaces malloc(), free() and their relatives, and
+// AudioThreadChecker.cpp, which replaces pthread_mutex_lock(). While a thread is marked, each
+// allocation, free and blocking lock of a CriticalSection or std::mutex is recorded with the call
+// stack that made it, and printReport() lists them once the run is over. Try-locks are allowed,
+// since they never wait, and SpinLocks aren't seen.
+//
+// Like AllocationCounter, this only works on Linux, and only in programs that link the .cpp
+// files, never the plugin itself.
+struct AudioThreadChecker
+{
+    // Marks the calling thread as an audio thread until it goes out of scope
+    struct ScopedAudioThread
+    {
+        ScopedAudioThread() noexcept : wasAudioThread(getFlag())
+        {
+            getFlag() = true;
+        }
+
+        ~ScopedAudioThread() noexcept
+        {
+            getFlag() = wasAudioThread;
+        }
+
+    private:
+        const bool wasAudioThread;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedAudioThread)
+    };
+
+    static bool isAudioThread() noexcept
+    {
+        return getFlag();
+    }
+
+    // The functions below are in AudioThreadChecker.cpp
+
+    // Call once before any audio runs. Reading a call stack allocates the first time, so this
+    // does it up front.
+    static void initialise();
+
+    // Called by the hooks when a marked thread allocates or locks. Doesn't allocate or lock.
+    static void recordViolation(const char* function) noexcept;
+
+    static int64 getNumViolations() noexcept;
+
+    // Lists every call site that allocated or locked on the audio thread and how often. Those
+    // whose call stack contains one of the allowed strings (function names, for example) are
+    // listed as allowed, and so are locks taken directly by a function whose name contains one of
+    // the allowedLockers. Unlike the allowed strings, those never let an allocation through.
+    // Returns the number of violations that weren't allowed.
+    static int64 printReport(std::ostream& stream, const StringArray& allowed,
+                             const StringArray& allowedLockers = {});
+
+private:
+    static bool& getFlag() noexcept
+    {
+        static thread_local bool isMarked = false;
+        return isMarked;
+    }
+};
@@ -0,0 +1,393 @@
+#pragma once
+
+#include "OfflineRenderer.h"
+
+// Renders a list of MIDI files on every core at once. This is the batch mode of the command line
+// renderer, see RenderMain.cpp.
+//
+// Each worker thread renders one job at a time with its own BasicSynth, created for the job so no
+// state carries over from the previous one. Jobs are shared out by work stealing: the list is
+// split into one contiguous run per worker, each worker takes jobs from the front of its own run,
+// and a worker whose run is empty steals from the back of another's. Jobs vary a lot in length,
+// so this keeps every core busy until the last few jobs without the workers fighting over one
+// queue for every job.
+//
+// Workers never touch the disk. They copy their audio into chunks taken from a fixed pool and
+// queue them for a single writer thread, which encodes and writes them in order and finishes each
+// file. The pool bounds the memory used: if the disk falls behind, a worker waits for a chunk to
+// be written before it renders more.
+struct BatchRenderer
+{
+    struct Job
+    {
+        File midiFile, stateFile, outputFile;
+
+        // Filled in as the job is rendered
+        Result result = Result::ok();
+        OfflineRenderer::Stats stats;
+
+    private:
+        friend struct BatchRenderer;
+
+        ScopedPointer<AudioFormatWriter> writer;
+        std::atomic<bool> writeFailed { false };
+    };
+
+    struct Stats
+    {
+        int numJobs = 0, numFailed = 0;
+        double audioSeconds = 0.0;
+        double wallSeconds = 0.0;
+
+        // Seconds of audio rendered by all the workers together per second of wall clock time
+        double getRealtimeMultiple() const noexcept
+        {
+            return wallSeconds > 0.0 ? audioSeconds / wallSeconds : 0.0;
+        }
+    };
+
+    // Samples per chunk, and chunks in the pool for each worker
+    static constexpr int chunkSize = 32768;
+    static constexpr int chunksPerWorker = 4;
+
+    // Reads a manifest, which has one job per line: the MIDI file, the state file and the output
+    // file, separated by tabs or commas. Use quotes around paths that contain either. An empty
+    // state file or "-" leaves the state at its defaults, and relative paths are relative to the
+    // manifest. Blank lines and lines starting with # are skipped.
+    static Result readManifest(const File& manifest, OwnedArray<Job>& jobs)
+    {
+        if (! manifest.existsAsFile())
+            return Result::fail("Couldn't read " + manifest.getFullPathName());
+
+        StringArray lines;
+        manifest.readLines(lines);
+
+        const auto directory = manifest.getParentDirectory();
+
+        for (auto i = 0; i < lines.size(); ++i)
+        {
+            const auto line = lines[i].trim();
+
+            if (line.isEmpty() || line.startsWithChar('#'))
+                continue;
+
+            StringArray fields;
+            fields.addTokens(line, "\t,", "\"");
+            fields.trim();
+            fields.removeEmptyStrings(false);
+
+            for (auto& field : fields)
+                field = field.unquoted();
+
+            if (fields.size() != 3)
+                return Result::fail(manifest.getFileName() + " line " + String(i + 1)
+                                    + ": expected a MIDI file, a state file and an output file");
+
+            auto* job = jobs.add(new Job());
+            job->midiFile = directory.getChildFile(fields[0]);
+            job->outputFile = directory.getChildFile(fields[2]);
+
+            if (fields[1] != "-")
+                job->stateFile = directory.getChildFile(fields[1]);
+        }
+
+        return Result::ok();
+    }
+
+    // The settings apply to every job, except for the state file, which each job sets itself
+    BatchRenderer(const OfflineRenderer::Settings& s, int numWorkersToUse)
+        : settings(s), numWorkers(jmax(1, numWorkersToUse))
+    {
+    }
+
+    // Called on the writer thread as each job finishes, in the order they finish
+    std::function<void (const Job&)> onJobFinished;
+
+    // Renders every job and returns once all the files are written
+    Stats run(OwnedArray<Job>& jobs)
+    {
+        Stats stats;
+        stats.numJobs = jobs.size();
+
+        if (jobs.isEmpty())
+            return stats;
+
+        const auto numThreads = jmin(numWorkers, jobs.size());
+
+        chunks.clear();
+        freeChunks.clearQuick();
+        queuedChunks.clearQuick();
+
+        for (auto i = 0; i < numThreads * chunksPerWorker; ++i)
+            freeChunks.add(chunks.add(new Chunk()));
+
+        workers.clear();
+
+        for (auto i = 0; i < numThreads; ++i)
+        {
+            auto* worker = workers.add(new Worker(*this, i));
+
+            // One contiguous run of the list each, in order
+            for (auto j = jobs.size() * i / numThreads; j < jobs.size() * (i + 1) / numThreads; ++j)
+                worker->jobs.add(jobs[j]);
+        }
+
+        const auto startTime = Time::getMillisecondCounterHiRes();
+
+        writer.startThread();
+
+        for (auto* worker : workers)
+            worker->startThread();
+
+        for (auto* worker : workers)
+            worker->waitForThreadToExit(-1);
+
+        // Everything has been queued by now, so the writer stops once the queue is empty
+        writer.signalThreadShouldExit();
+        writer.notify();
+        writer.waitForThreadToExit(-1);
+
+        stats.wallSeconds = (Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+
+        for (auto* job : jobs)
+        {
+            stats.audioSeconds += job->stats.audioSeconds;
+
+            if (job->result.failed())
+                ++stats.numFailed;
+        }
+
+        workers.clear();
+        chunks.clear();
+        freeChunks.clear();
+        return stats;
+    }
+
+private:
+    struct Chunk
+    {
+        AudioBuffer<float> buffer { 2, chunkSize };
+        int numSamples = 0;
+        Job* job = nullptr;
+        bool isLastChunk = false;
+    };
+
+    struct Worker : public Thread
+    {
+        Worker(BatchRenderer& o, int index) : Thread("Batch render worker " + String(index)), owner(o) {}
+
+        void run() override
+        {
+            while (auto* job = owner.takeJob(*this))
+                owner.renderJob(*job);
+        }
+
+        BatchRenderer& owner;
+
+        // Taken from the front by this worker and from the back by the others
+        SpinLock lock;
+        Array<Job*> jobs;
+    };
+
+    struct Writer : public Thread
+    {
+        Writer(BatchRenderer& o) : Thread("Batch render writer"), owner(o) {}
+
+        void run() override
+        {
+            for (;;)
+            {
+                if (auto* chunk = owner.getNextQueuedChunk())
+                {
+                    owner.writeChunk(*chunk);
+                    owner.releaseChunk(chunk);
+                    continue;
+                }
+
+                if (threadShouldExit())
+                    return;
+
+                wait(-1);
+            }
+        }
+
+        BatchRenderer& owner;
+    };
+
+    Job* takeJob(Worker& worker)
+    {
+        {
+            const SpinLock::ScopedLockType sl(worker.lock);
+
+            if (! worker.jobs.isEmpty())
+                return worker.jobs.removeAndReturn(0);
+        }
+
+        // Steal from whichever worker has the most left, which is the one least likely to be
+        // about to run out itself
+        for (;;)
+        {
+            Worker* victim = nullptr;
+            auto mostJobs = 0;
+
+            for (auto* other : workers)
+            {
+                if (other == &worker)
+                    continue;
+
+                const SpinLock::ScopedLockType sl(other->lock);
+
+                if (other->jobs.size() > mostJobs)
+                {
+                    victim = other;
+                    mostJobs = other->jobs.size();
+                }
+            }
+
+            if (victim == nullptr)
+                return nullptr;
+
+            const SpinLock::ScopedLockType sl(victim->lock);
+
+            // Someone else may have got there first, in which case look again
+            if (! victim->jobs.isEmpty())
+                return victim->jobs.removeAndReturn(victim->jobs.size() - 1);
+        }
+    }
+
+    void renderJob(Job& job)
+    {
+        auto jobSettings = settings;
+        jobSettings.stateFile = job.stateFile;
+
+        job.writer = OfflineRenderer::createWriter(job.outputFile, jobSettings);
+
+        Chunk* chunk = nullptr;
+
+        if (job.writer == nullptr)
+        {
+            job.result = Result::fail("Couldn't create " + job.outputFile.getFullPathName());
+        }
+        else
+        {
+            job.result = OfflineRenderer::render(job.midiFile, jobSettings, job.stats, [&](const AudioBuffer<float>& block)
+            {
+                for (auto position = 0; position < block.getNumSamples();)
+                {
+                    if (chunk == nullptr)
+                        chunk = getFreeChunk(job);
+
+                    const auto numSamples = jmin(block.getNumSamples() - position, chunkSize - chunk->numSamples);
+
+                    for (auto ch = 0; ch < chunk->buffer.getNumChannels(); ++ch)
+                        chunk->buffer.copyFrom(ch, chunk->numSamples, block, ch, position, numSamples);
+
+                    chunk->numSamples += numSamples;
+                    position += numSamples;
+
+                    if (chunk->numSamples == chunkSize)
+                    {
+                        queueChunk(chunk);
+                        chunk = nullptr;
+                    }
+                }
+
+                // Gives up early once the disk has failed
+                return ! job.writeFailed.load();
+            });
+        }
+
+        // The last chunk finishes the file, so a job always ends with one, even an empty one
+        if (chunk == nullptr)
+            chunk = getFreeChunk(job);
+
+        chunk->isLastChunk = true;
+        queueChunk(chunk);
+    }
+
+    Chunk* getFreeChunk(Job& job)
+    {
+        for (;;)
+        {
+            {
+                const ScopedLock sl(queueLock);
+
+                if (! freeChunks.isEmpty())
+                {
+                    auto* chunk = freeChunks.removeAndReturn(freeChunks.size() - 1);
+
+                    // Pass the wake-up on in case another worker is waiting too
+                    if (! freeChunks.isEmpty())
+                        chunkFreed.signal();
+
+                    chunk->job = &job;
+                    chunk->numSamples = 0;
+                    chunk->isLastChunk = false;
+                    return chunk;
+                }
+            }
+
+            chunkFreed.wait();
+        }
+    }
+
+    void queueChunk(Chunk* chunk)
+    {
+        {
+            const ScopedLock sl(queueLock);
+            queuedChunks.add(chunk);
+        }
+
+        writer.notify();
+    }
+
+    Chunk* getNextQueuedChunk()
+    {
+        const ScopedLock sl(queueLock);
+        return queuedChunks.isEmpty() ? nullptr : queuedChunks.removeAndReturn(0);
+    }
+
+    void releaseChunk(Chunk* chunk)
+    {
+        {
+            const ScopedLock sl(queueLock);
+            freeChunks.add(chunk);
+        }
+
+        chunkFreed.signal();
+    }
+
+    void writeChunk(Chunk& chunk)
+    {
+        auto& job = *chunk.job;
+
+        if (job.writer != nullptr && ! job.writeFailed && chunk.numSamples > 0
+             && ! job.writer->writeFromAudioSampleBuffer(chunk.buffer, 0, chunk.numSamples))
+            job.writeFailed = true;
+
+        if (! chunk.isLastChunk)
+            return;
+
+        // Deleting the writer finishes off the file
+        job.writer = nullptr;
+
+        if (job.writeFailed && job.result.wasOk())
+            job.result = Result::fail("Couldn't write to " + job.outputFile.getFullPathName());
+
+        if (onJobFinished != nullptr)
+            onJobFinished(job);
+    }
+
+    OfflineRenderer::Settings settings;
+    int numWorkers;
+
+    OwnedArray<Worker> workers;
+    OwnedArray<Chunk> chunks;
+    Array<Chunk*> freeChunks, queuedChunks;
+    CriticalSection queueLock;
+    WaitableEvent chunkFreed;
+
+    Writer writer { *this };
+
+    JUCE_DECLARE_NON_COPYABLE(BatchRenderer)
+};
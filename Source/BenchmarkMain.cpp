@@ -0,0 +1,218 @@
+// A command line tool that times BasicSynth::processBlock() over a sweep of settings, see
+// ProcessBlockBenchmark.h, or with --kernels the inner loops on their own, see KernelBenchmark.h.
+// Built by the Benchmark target of Builds/LinuxMakefile/Tools.mk, it isn't part of the plugin.
+// Build it with CONFIG=Release, a debug build measures the assertions.
+//
+//   BasicSynthBenchmark [--full] [--seconds <s>] [--output results.json]
+//                       [--baseline baseline.json [--tolerance 0.1] [--update-baseline]]
+//   BasicSynthBenchmark --kernels [--filter <text>] [--output results.json]
+//
+// The results are written as JSON, to stdout unless there is an --output file, and progress goes
+// to stderr. With a baseline, the exit code is 1 if any case got slower than the tolerance allows
+// or allocates more than before, so it can gate changes to Source/. --update-baseline writes the
+// results to the baseline file instead, for the first run or after an intended change. Baselines
+// are only comparable on the machine that wrote them.
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "ProcessBlockBenchmark.h"
+#include "KernelBenchmark.h"
+
+#include <iostream>
+
+static void printUsage()
+{
+    std::cout << "Usage: BasicSynthBenchmark [options]" << std::endl
+              << std::endl
+              << "  --full                  every combination of settings instead of one at a time" << std::endl
+              << "  --seconds <s>           audio timed per case, default 2" << std::endl
+              << "  --output <file.json>    where to write the results, default stdout" << std::endl
+              << "  --baseline <file.json>  fails if any case is slower than in this file" << std::endl
+              << "  --tolerance <fraction>  slowdown allowed against the baseline, default 0.1" << std::endl
+              << "  --update-baseline       writes the results to the baseline file instead" << std::endl
+              << "  --kernels               times the inner loops on their own instead" << std::endl
+              << "  --filter <text>         only the kernels whose names contain the text" << std::endl;
+}
+
+static String runKernelBenchmarks(const String& filter)
+{
+    OwnedArray<KernelBenchmark::Kernel> kernels;
+    KernelBenchmark::createKernels(kernels);
+
+    KernelBenchmark benchmark;
+    Array<KernelBenchmark::Result> results;
+
+    for (auto* kernel : kernels)
+    {
+        if (! kernel->name.contains(filter))
+            continue;
+
+        for (auto coldCache : { false, true })
+        {
+            const auto result = benchmark.measure(*kernel, coldCache);
+            results.add(result);
+
+            std::cerr << result.name << (coldCache ? " (cold): " : " (hot): ")
+                      << String(result.nsPerSample.median, 2) << " ns/sample, "
+                      << String(result.cyclesPerSample.median, 1) << " cycles/sample, p99 "
+                      << String(result.nsPerSample.p99, 2) << " ns, sd "
+                      << String(result.nsPerSample.standardDeviation, 2) << " ns" << std::endl;
+        }
+    }
+
+    return JSON::toString(KernelBenchmark::toVar(results));
+}
+
+int main(int argc, char* argv[])
+{
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    auto full = false, updateBaseline = false, kernels = false;
+    auto seconds = 2.0, tolerance = 0.1;
+    File outputFile, baselineFile;
+    String filter;
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        const auto arg = String::fromUTF8(argv[i]);
+
+        if (arg == "--help" || arg == "-h")
+        {
+            printUsage();
+            return 0;
+        }
+
+        if (arg == "--full")
+        {
+            full = true;
+            continue;
+        }
+
+        if (arg == "--update-baseline")
+        {
+            updateBaseline = true;
+            continue;
+        }
+
+        if (arg == "--kernels")
+        {
+            kernels = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+
+        const auto value = String::fromUTF8(argv[++i]);
+
+        if (arg == "--seconds")
+            seconds = value.getDoubleValue();
+        else if (arg == "--output")
+            outputFile = File::getCurrentWorkingDirectory().getChildFile(value);
+        else if (arg == "--baseline")
+            baselineFile = File::getCurrentWorkingDirectory().getChildFile(value);
+        else if (arg == "--tolerance")
+            tolerance = value.getDoubleValue();
+        else if (arg == "--filter")
+            filter = value;
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (seconds <= 0.0 || tolerance < 0.0 || (updateBaseline && baselineFile == File())
+         || (kernels && baselineFile != File()))
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (kernels)
+    {
+        const auto json = runKernelBenchmarks(filter);
+
+        if (outputFile == File())
+            std::cout << json << std::endl;
+        else if (! outputFile.replaceWithText(json))
+            std::cerr << "Couldn't write " << outputFile.getFullPathName() << std::endl;
+
+        return 0;
+    }
+
+    if (! AllocationCounter::isAvailable())
+        std::cerr << "Allocations can't be counted on this platform" << std::endl;
+
+    TemporaryFile impulseResponse(".wav");
+
+    ProcessBlockBenchmark benchmark;
+    benchmark.impulseResponseFile = impulseResponse.getFile();
+
+    if (! ProcessBlockBenchmark::createImpulseResponse(benchmark.impulseResponseFile))
+    {
+        std::cerr << "Couldn't write an impulse response to " << benchmark.impulseResponseFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    const auto configs = full ? ProcessBlockBenchmark::getFullSweep() : ProcessBlockBenchmark::getQuickSweep();
+    Array<ProcessBlockBenchmark::Result> results;
+
+    for (auto& config : configs)
+    {
+        const auto result = benchmark.run(config, seconds);
+        results.add(result);
+
+        std::cerr << config.getName() << ": " << String(result.nsPerSample, 2) << " ns/sample, p50 "
+                  << String(result.medianBlockMs, 3) << " ms, p99 " << String(result.p99BlockMs, 3)
+                  << " ms, max " << String(result.maxBlockMs, 3) << " ms, "
+                  << String(result.allocationsPerBlock, 2) << " allocations per block" << std::endl;
+    }
+
+    const auto json = JSON::toString(ProcessBlockBenchmark::toVar(results));
+
+    if (updateBaseline)
+    {
+        if (! baselineFile.replaceWithText(json))
+        {
+            std::cerr << "Couldn't write " << baselineFile.getFullPathName() << std::endl;
+            return 1;
+        }
+
+        std::cerr << "Wrote the baseline to " << baselineFile.getFullPathName() << std::endl;
+    }
+
+    if (outputFile != File())
+    {
+        if (! outputFile.replaceWithText(json))
+        {
+            std::cerr << "Couldn't write " << outputFile.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+    else if (! updateBaseline)
+    {
+        std::cout << json << std::endl;
+    }
+
+    if (baselineFile == File() || updateBaseline)
+        return 0;
+
+    const auto baseline = JSON::parse(baselineFile);
+
+    if (baseline.isVoid())
+    {
+        std::cerr << "Couldn't read the baseline " << baselineFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    const auto regressions = ProcessBlockBenchmark::compareWithBaseline(results, baseline, tolerance);
+
+    for (auto& regression : regressions)
+        std::cerr << "Regression: " << regression << std::endl;
+
+    std::cerr << regressions.size() << " regressions against " << baselineFile.getFileName() << std::endl;
+    return regressions.isEmpty() ? 0 : 1;
+}
@@ -0,0 +1,917 @@
+#pragma once
+
+// One channel of uniformly partitioned convolution in the frequency domain.
+//
+// The impulse response is cut into partitions of partitionSize samples, and each one is
+// transformed once, up front. Input is collected in blocks of the same size. Every block's
+// spectrum is kept in a ring (the frequency domain delay line), so the output for the current
+// block is the inverse transform of the sum of each partition's spectrum times the spectrum of
+// the block that is that many blocks old. With a window of two blocks and the second half of the
+// inverse transform kept (overlap-save) this is exactly the linear convolution.
+//
+// There is no latency: a block that is only partly filled is transformed as it is, zero padded,
+// which gives the right output for the samples it does have. The older blocks can only
+// contribute to the current block, so their sum is worked out once when the block starts, and
+// each call only has to add the first partition's product to it.
+struct PartitionedConvolver
+{
+    // Transforms the impulse response. This allocates, so it belongs on a background thread.
+    void prepare(const float* impulse, int impulseLength, int newPartitionSize)
+    {
+        jassert(isPowerOfTwo(newPartitionSize));
+
+        partitionSize = newPartitionSize;
+        numBins = partitionSize + 1;
+        numPartitions = jmax(1, (impulseLength + partitionSize - 1) / partitionSize);
+
+        fft = new dsp::FFT(roundToInt(std::log2(2 * partitionSize)));
+
+        // The FFT works in place, on twice as many floats as its size
+        fftBuffer.calloc((size_t)(4 * partitionSize));
+        window.calloc((size_t)(2 * partitionSize));
+        impulseSpectra.calloc((size_t)(numPartitions * 2 * numBins));
+        inputSpectra.calloc((size_t)(numPartitions * 2 * numBins));
+        previousBlocksSum.calloc((size_t)(2 * numBins));
+        outputSpectrum.calloc((size_t)(2 * numBins));
+
+        for (auto partition = 0; partition < numPartitions; ++partition)
+        {
+            const auto start = partition * partitionSize;
+
+            FloatVectorOperations::clear(fftBuffer, 4 * partitionSize);
+            FloatVectorOperations::copy(fftBuffer, impulse + start, jmin(partitionSize, impulseLength - start));
+
+            fft->performRealOnlyForwardTransform(fftBuffer, true);
+            deinterleave(fftBuffer, getSpectrum(impulseSpectra, partition));
+        }
+
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        FloatVectorOperations::clear(window, 2 * partitionSize);
+        FloatVectorOperations::clear(inputSpectra, numPartitions * 2 * numBins);
+        FloatVectorOperations::clear(previousBlocksSum, 2 * numBins);
+
+        inputPosition = 0;
+        currentBlock = 0;
+    }
+
+    int getPartitionSize() const noexcept
+    {
+        return partitionSize;
+    }
+
+    // Convolves the input and adds the result to the output. Any number of samples can be
+    // processed at a time, but calls that stop on a partition boundary are the cheapest.
+    void processAdding(const float* input, float* output, int numSamples) noexcept
+    {
+        while (numSamples > 0)
+        {
+            const auto numThisTime = jmin(numSamples, partitionSize - inputPosition);
+
+            if (inputPosition == 0)
+                sumPreviousBlocks();
+
+            FloatVectorOperations::copy(window + partitionSize + inputPosition, input, numThisTime);
+
+            FloatVectorOperations::copy(fftBuffer, window, 2 * partitionSize);
+            fft->performRealOnlyForwardTransform(fftBuffer, true);
+
+            auto* spectrum = getSpectrum(inputSpectra, currentBlock);
+            deinterleave(fftBuffer, spectrum);
+
+            FloatVectorOperations::copy(outputSpectrum, previousBlocksSum, 2 * numBins);
+            multiplyAdding(outputSpectrum, spectrum, getSpectrum(impulseSpectra, 0));
+
+            interleave(outputSpectrum, fftBuffer);
+            fft->performRealOnlyInverseTransform(fftBuffer);
+
+            FloatVectorOperations::add(output, fftBuffer + partitionSize + inputPosition, numThisTime);
+
+            input += numThisTime;
+            output += numThisTime;
+            numSamples -= numThisTime;
+            inputPosition += numThisTime;
+
+            if (inputPosition == partitionSize)
+            {
+                // The block is complete, so slide the window on and start the next one
+                FloatVectorOperations::copy(window, window + partitionSize, partitionSize);
+                FloatVectorOperations::clear(window + partitionSize, partitionSize);
+
+                inputPosition = 0;
+                currentBlock = (currentBlock + 1) % numPartitions;
+            }
+        }
+    }
+
+private:
+    // Spectra are stored split, the real parts followed by the imaginary ones, so the complex
+    // multiplications can be done with FloatVectorOperations
+    float* getSpectrum(float* spectra, int index) const noexcept
+    {
+        return spectra + index * 2 * numBins;
+    }
+
+    void sumPreviousBlocks() noexcept
+    {
+        FloatVectorOperations::clear(previousBlocksSum, 2 * numBins);
+
+        for (auto partition = 1; partition < numPartitions; ++partition)
+        {
+            const auto block = (currentBlock + numPartitions - partition) % numPartitions;
+            multiplyAdding(previousBlocksSum, getSpectrum(inputSpectra, block), getSpectrum(impulseSpectra, partition));
+        }
+    }
+
+    void multiplyAdding(float* sum, const float* a, const float* b) const noexcept
+    {
+        auto* sumImag = sum + numBins;
+        const auto* aImag = a + numBins;
+        const auto* bImag = b + numBins;
+
+        FloatVectorOperations::addWithMultiply     (sum,     a,     b,     numBins);
+        FloatVectorOperations::subtractWithMultiply(sum,     aImag, bImag, numBins);
+        FloatVectorOperations::addWithMultiply     (sumImag, a,     bImag, numBins);
+        FloatVectorOperations::addWithMultiply     (sumImag, aImag, b,     numBins);
+    }
+
+    void deinterleave(const float* source, float* spectrum) const noexcept
+    {
+        for (auto i = 0; i < numBins; ++i)
+        {
+            spectrum[i]           = source[2 * i];
+            spectrum[numBins + i] = source[2 * i + 1];
+        }
+    }
+
+    void interleave(const float* spectrum, float* dest) const noexcept
+    {
+        for (auto i = 0; i < numBins; ++i)
+        {
+            dest[2 * i]     = spectrum[i];
+            dest[2 * i + 1] = spectrum[numBins + i];
+        }
+    }
+
+    ScopedPointer<dsp::FFT> fft;
+
+    int partitionSize = 0, numBins = 0, numPartitions = 0;
+    int inputPosition = 0, currentBlock = 0;
+
+    HeapBlock<float> fftBuffer, window;
+    HeapBlock<float> impulseSpectra, inputSpectra, previousBlocksSum, outputSpectrum;
+};
+
+//==================================================================================================
+// A convolution reverb for long impulse responses, with non-uniform partitioning.
+//
+// The start of the impulse response (the head) is convolved on the audio thread with short
+// partitions the size of the audio block, so there is no latency. The rest (the tail) is
+// convolved with partitions 8 times longer on a background thread, which is far cheaper per
+// sample. The tail's first partition starts two tail blocks into the impulse response, so a tail
+// block can be rendered as soon as its input is complete and still has a whole block's worth of
+// time before the audio thread needs it.
+//
+// In real time the audio thread never renders the tail itself. If the background thread falls
+// behind, the late block is left out: near the end of each tail block the audio thread checks
+// that the next one is ready, and if it isn't, fades the tail out over the last headSize samples
+// so it stops without a click, then fades it back in at the start of the first block that is
+// ready in time (see getNumLateTailBlocks()). The background thread still renders the blocks it
+// missed, in order, so the tail stays correct once it catches up. The input is kept for
+// numTailSlots blocks, and a block whose input the audio thread has already overwritten is
+// rendered as silence.
+//
+// Rendering offline, the audio thread runs as fast as it can and would leave out most of the
+// tail, so in non-realtime mode it never does: a block that isn't ready yet is rendered on the
+// audio thread, or waited for if the background thread is already part way through it. The
+// output is then the exact convolution, however fast or slow the caller is.
+//
+// Impulse responses are read, resampled, normalised and transformed on a loading thread, and the
+// finished engine is handed to the audio thread through an atomic pointer. The audio thread
+// crossfades from the old engine to the new one over one block, and hands the old one back to be
+// deleted. It never allocates, frees or waits on a lock, and only waits on the tail thread in
+// non-realtime mode.
+struct ConvolutionReverb
+{
+    ConvolutionReverb() : tailThread(*this), loaderThread(*this) {}
+
+    ~ConvolutionReverb()
+    {
+        stopThreads();
+        deleteEngines();
+    }
+
+    // Reads the impulse response on the loading thread, and swaps it in once it is ready
+    void loadImpulseResponse(const File& file)
+    {
+        {
+            const ScopedLock sl(requestLock);
+            requestedFile = file;
+            requestedBuffer.setSize(0, 0);
+            hasRequest = true;
+        }
+
+        loaderThread.notify();
+    }
+
+    // As above, for an impulse response that is already in memory
+    void loadImpulseResponse(const AudioBuffer<float>& buffer, double bufferSampleRate)
+    {
+        {
+            const ScopedLock sl(requestLock);
+            requestedFile = File();
+            requestedBuffer.makeCopyOf(buffer);
+            requestedSampleRate = bufferSampleRate;
+            hasRequest = true;
+        }
+
+        loaderThread.notify();
+    }
+
+    bool hasImpulseResponse() const
+    {
+        const ScopedLock sl(requestLock);
+        return impulseResponse.getNumSamples() > 0;
+    }
+
+    File getImpulseResponseFile() const
+    {
+        const ScopedLock sl(requestLock);
+        return impulseResponseFile;
+    }
+
+    // The length of the impulse response the audio thread is using, 0 without one. Audio thread
+    // only.
+    double getTailLengthSeconds() const noexcept
+    {
+        return currentEngine != nullptr ? currentEngine->lengthSeconds : 0.0;
+    }
+
+    // The number of tail blocks that weren't ready in time and were left out
+    int getNumLateTailBlocks() const noexcept
+    {
+        return numLateTailBlocks.load(std::memory_order_relaxed);
+    }
+
+    // In non-realtime mode the tail is always complete, see above. Call it before prepare(), or
+    // while audio isn't running.
+    void setNonRealtime(bool isNonRealtime) noexcept
+    {
+        nonRealtime = isNonRealtime;
+    }
+
+    // Both levels are scaled like Reverb::Parameters, so switching between the two reverbs
+    // doesn't change the balance
+    void setWetLevel(float newValue) noexcept
+    {
+        wetGain.setValue(newValue * 2.0f);
+    }
+
+    void setDryLevel(float newValue) noexcept
+    {
+        dryGain.setValue(newValue * 2.0f);
+    }
+
+    //==============================================================================
+    // The same interface as dsp::Reverb
+
+    bool isEnabled() const noexcept
+    {
+        return enabled;
+    }
+
+    void setEnabled(bool newValue) noexcept
+    {
+        enabled = newValue;
+    }
+
+    // Rebuilds the current impulse response for the new spec before returning, so it must not
+    // be called while audio is running
+    void prepare(const dsp::ProcessSpec& spec)
+    {
+        stopThreads();
+        deleteEngines();
+
+        // An impulse response that was asked for but hasn't been loaded yet is read here instead,
+        // so processing always starts with the latest one. That matters when rendering offline,
+        // where the first block follows straight on. Without a spec this only reads the file.
+        {
+            const ScopedLock sl(requestLock);
+            currentSpec = { 0.0, 0, 0 };
+        }
+
+        loadRequestedImpulseResponse();
+
+        numChannels = jlimit(1, 2, (int)spec.numChannels);
+        maximumBlockSize = (int)spec.maximumBlockSize;
+
+        wetBuffer.setSize(numChannels, maximumBlockSize);
+        fadeBuffer.setSize(numChannels, maximumBlockSize);
+
+        wetGain.reset(spec.sampleRate, 0.05);
+        dryGain.reset(spec.sampleRate, 0.05);
+
+        {
+            const ScopedLock sl(requestLock);
+            currentSpec = spec;
+
+            if (impulseResponse.getNumSamples() > 0)
+                currentEngine = new Engine(impulseResponse, impulseResponseSampleRate, spec);
+        }
+
+        activeEngine.store(currentEngine, std::memory_order_release);
+        startThreads();
+    }
+
+    // Clears the reverb's state. Must not be called while audio is running.
+    void reset()
+    {
+        tailThread.stopThread(1000);
+
+        if (currentEngine != nullptr)
+            currentEngine->reset();
+
+        tailThread.startThread(tailThreadPriority);
+    }
+
+    // Stops the background threads and frees the engines until the next prepare(), which starts
+    // them again. The impulse response is kept. Must not be called while audio is running.
+    void release()
+    {
+        stopThreads();
+        deleteEngines();
+    }
+
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        const auto& inputBlock = context.getInputBlock();
+        auto& outputBlock = context.getOutputBlock();
+        const auto numSamples = (int)outputBlock.getNumSamples();
+
+        jassert(inputBlock.getNumSamples() == (size_t)numSamples);
+
+        outputBlock.copy(inputBlock);
+
+        // Without prepare() there is nothing to process with
+        if (! enabled || context.isBypassed || maximumBlockSize == 0)
+            return;
+
+        // A mono block only goes through the first channel's convolution. The second one, if it
+        // was prepared, is fed silence.
+        const auto numBlockChannels = jmin(numChannels, (int)outputBlock.getNumChannels());
+
+        float* channels[2] = { outputBlock.getChannelPointer(0),
+                               numBlockChannels > 1 ? outputBlock.getChannelPointer(1) : nullptr };
+
+        for (auto start = 0; start < numSamples; start += maximumBlockSize)
+        {
+            const auto numThisTime = jmin(maximumBlockSize, numSamples - start);
+            float* chunk[2] = { channels[0] + start, numBlockChannels > 1 ? channels[1] + start : nullptr };
+
+            processChunk(chunk, numBlockChannels, numThisTime);
+        }
+    }
+
+private:
+    //==============================================================================
+    // Everything needed to convolve with one impulse response at one sample rate and block size
+    struct Engine
+    {
+        Engine(const AudioBuffer<float>& impulse, double impulseSampleRate, const dsp::ProcessSpec& spec)
+        {
+            numChannels = jlimit(1, 2, (int)spec.numChannels);
+
+            AudioBuffer<float> resampled;
+            resample(impulse, impulseSampleRate, spec.sampleRate, resampled);
+            normalise(resampled);
+
+            const auto length = resampled.getNumSamples();
+            lengthSeconds = length / spec.sampleRate;
+
+            headSize = jlimit(64, 1024, nextPowerOfTwo((int)spec.maximumBlockSize));
+            tailSize = headSize * 8;
+
+            // Short impulse responses are convolved entirely on the audio thread
+            if (length <= 2 * tailSize)
+                tailSize = 0;
+
+            const auto headLength = tailSize > 0 ? 2 * tailSize : length;
+
+            for (auto ch = 0; ch < numChannels; ++ch)
+            {
+                const auto* data = resampled.getReadPointer(jmin(ch, resampled.getNumChannels() - 1));
+
+                head[ch].prepare(data, headLength, headSize);
+
+                if (tailSize > 0)
+                    tail[ch].prepare(data + headLength, length - headLength, tailSize);
+            }
+
+            if (tailSize > 0)
+            {
+                tailInput.calloc((size_t)(numChannels * numTailSlots * tailSize));
+                tailOutput.calloc((size_t)(numChannels * numTailSlots * tailSize));
+                tailScratch.calloc((size_t)tailSize);
+            }
+        }
+
+        void reset() noexcept
+        {
+            for (auto ch = 0; ch < numChannels; ++ch)
+            {
+                head[ch].reset();
+
+                if (tailSize > 0)
+                    tail[ch].reset();
+            }
+
+            if (tailSize > 0)
+            {
+                FloatVectorOperations::clear(tailInput, numChannels * numTailSlots * tailSize);
+                FloatVectorOperations::clear(tailOutput, numChannels * numTailSlots * tailSize);
+            }
+
+            samplePosition = 0;
+            tailGain = 1.0f;
+            isTailBlockLeftOut = false;
+            blocksAvailable.store(0, std::memory_order_relaxed);
+            blocksClaimed.store(0, std::memory_order_relaxed);
+            blocksDone.store(0, std::memory_order_relaxed);
+        }
+
+        // Audio thread. Writes the reverb of the first numInputChannels channels of the input to
+        // the output, and returns the number of tail blocks that weren't ready in time. With
+        // waitForTail, none are, see renderTailBlocksUpTo().
+        int process(float* const* input, float* const* output, int numInputChannels, int numSamples,
+                    bool waitForTail) noexcept
+        {
+            auto numLate = 0;
+            const auto numChannelsToUse = jmin(numChannels, numInputChannels);
+
+            for (auto ch = 0; ch < numChannelsToUse; ++ch)
+                FloatVectorOperations::clear(output[ch], numSamples);
+
+            for (auto start = 0; start < numSamples;)
+            {
+                // Work in chunks that don't cross the end of a tail block
+                const auto positionInBlock = tailSize > 0 ? (int)(samplePosition % tailSize) : 0;
+                const auto numThisTime = tailSize > 0 ? jmin(numSamples - start, tailSize - positionInBlock)
+                                                      : numSamples - start;
+
+                for (auto ch = 0; ch < numChannelsToUse; ++ch)
+                    head[ch].processAdding(input[ch] + start, output[ch] + start, numThisTime);
+
+                if (tailSize > 0)
+                {
+                    const auto currentBlock = samplePosition / tailSize;
+
+                    if (positionInBlock == 0)
+                    {
+                        if (waitForTail)
+                            renderTailBlocksUpTo(currentBlock - 2);
+
+                        // A block that isn't ready now stays out, even if it turns up part way
+                        // through, as the tail has already been faded out for it
+                        isTailBlockLeftOut = ! isTailBlockReady(currentBlock - 2);
+
+                        if (isTailBlockLeftOut)
+                            ++numLate;
+
+                        // Keeps the new input from showing before this block was published, see
+                        // renderNextTailBlock()
+                        std::atomic_thread_fence(std::memory_order_release);
+                    }
+
+                    // The tail block that ends two blocks before the current one
+                    addTailOutput(output, numChannelsToUse, currentBlock - 2, positionInBlock, start, numThisTime,
+                                  waitForTail);
+
+                    for (auto ch = 0; ch < numChannels; ++ch)
+                    {
+                        auto* slot = getTailSlot(tailInput, ch, currentBlock) + positionInBlock;
+
+                        if (ch < numChannelsToUse)
+                            FloatVectorOperations::copy(slot, input[ch] + start, numThisTime);
+                        else
+                            FloatVectorOperations::clear(slot, numThisTime);
+                    }
+
+                    if (positionInBlock + numThisTime == tailSize)
+                        blocksAvailable.store(currentBlock + 1, std::memory_order_release);
+                }
+
+                samplePosition += numThisTime;
+                start += numThisTime;
+            }
+
+            return numLate;
+        }
+
+        // Any thread. Renders the next tail block if its input is complete and nobody else is
+        // already rendering one, which keeps the blocks in order.
+        bool renderNextTailBlock() noexcept
+        {
+            if (tailSize == 0)
+                return false;
+
+            auto block = blocksClaimed.load(std::memory_order_acquire);
+
+            if (block >= blocksAvailable.load(std::memory_order_acquire)
+                 || blocksDone.load(std::memory_order_acquire) != block
+                 || ! blocksClaimed.compare_exchange_strong(block, block + 1, std::memory_order_acq_rel))
+                return false;
+
+            for (auto ch = 0; ch < numChannels; ++ch)
+            {
+                // The input is copied out first, in case the audio thread is so far ahead that it
+                // is already writing a newer block into the same slot. Such a block is rendered as
+                // silence, which keeps the convolution in step.
+                FloatVectorOperations::copy(tailScratch, getTailSlot(tailInput, ch, block), tailSize);
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                if (blocksAvailable.load(std::memory_order_relaxed) >= block + numTailSlots)
+                    FloatVectorOperations::clear(tailScratch, tailSize);
+
+                // The audio thread doesn't read a slot until its block is done, and by the time
+                // this one comes round again the block there has been played or left out
+                auto* output = getTailSlot(tailOutput, ch, block);
+
+                FloatVectorOperations::clear(output, tailSize);
+                tail[ch].processAdding(tailScratch, output, tailSize);
+            }
+
+            blocksDone.store(block + 1, std::memory_order_release);
+            return true;
+        }
+
+        // The length of the impulse response after resampling
+        double lengthSeconds = 0.0;
+
+    private:
+        static void resample(const AudioBuffer<float>& source, double sourceSampleRate, double sampleRate,
+                             AudioBuffer<float>& dest)
+        {
+            if (sourceSampleRate == sampleRate)
+            {
+                dest.makeCopyOf(source);
+                return;
+            }
+
+            const auto ratio = sourceSampleRate / sampleRate;
+            const auto numSourceSamples = source.getNumSamples();
+
+            // The interpolator can look a few samples past the end
+            AudioBuffer<float> padded(source.getNumChannels(), numSourceSamples + 8);
+            padded.clear();
+
+            dest.setSize(source.getNumChannels(), jmax(1, (int)(numSourceSamples / ratio)));
+
+            for (auto ch = 0; ch < source.getNumChannels(); ++ch)
+            {
+                padded.copyFrom(ch, 0, source, ch, 0, numSourceSamples);
+
+                LagrangeInterpolator interpolator;
+                interpolator.process(ratio, padded.getReadPointer(ch), dest.getWritePointer(ch), dest.getNumSamples());
+            }
+        }
+
+        // The same level as dsp::Convolution's normalisation
+        static void normalise(AudioBuffer<float>& buffer)
+        {
+            auto energy = 0.0;
+
+            for (auto ch = 0; ch < buffer.getNumChannels(); ++ch)
+            {
+                const auto* data = buffer.getReadPointer(ch);
+
+                for (auto i = 0; i < buffer.getNumSamples(); ++i)
+                    energy += data[i] * data[i];
+            }
+
+            energy /= buffer.getNumChannels();
+
+            if (energy > 0.0)
+                buffer.applyGain((float)(0.125 / std::sqrt(energy)));
+        }
+
+        // Blocks take turns in numTailSlots slots per channel
+        float* getTailSlot(float* storage, int channel, int64 block) const noexcept
+        {
+            return storage + (channel * numTailSlots + (int)(block % numTailSlots)) * tailSize;
+        }
+
+        // The blocks before the first are silent, so always ready
+        bool isTailBlockReady(int64 block) const noexcept
+        {
+            return block < 0 || blocksDone.load(std::memory_order_acquire) > block;
+        }
+
+        // Non-realtime only. Renders the tail blocks up to this one on the calling thread. The
+        // only time it has to wait is while the background thread finishes a block it started.
+        void renderTailBlocksUpTo(int64 block) noexcept
+        {
+            while (! isTailBlockReady(block))
+                if (! renderNextTailBlock())
+                    Thread::yield();
+        }
+
+        // Adds part of a finished tail block to the output, fading the tail out over the end of the
+        // block if the next one isn't ready yet, and back in at the start of the next block that is.
+        // With waitForTail the next one will be rendered in time, so there is no fade.
+        void addTailOutput(float* const* output, int numChannelsToUse, int64 block, int positionInBlock,
+                           int start, int numSamples, bool waitForTail) noexcept
+        {
+            if (block < 0)
+                return;
+
+            if (isTailBlockLeftOut)
+            {
+                tailGain = 0.0f;
+                return;
+            }
+
+            // Checked as late as possible, to give the background thread every chance
+            const auto fadeStart = tailSize - headSize;
+            const auto target = waitForTail || positionInBlock + numSamples <= fadeStart || isTailBlockReady(block + 1)
+                                  ? 1.0f : 0.0f;
+
+            if (tailGain == target)
+            {
+                if (target > 0.0f)
+                    for (auto ch = 0; ch < numChannelsToUse; ++ch)
+                        FloatVectorOperations::add(output[ch] + start, getTailSlot(tailOutput, ch, block) + positionInBlock,
+                                                   numSamples);
+                return;
+            }
+
+            // Fading out only starts at fadeStart, so that it is over by the end of the block
+            const auto step = 1.0f / (float)headSize;
+            auto gain = tailGain;
+
+            for (auto i = 0; i < numSamples; ++i)
+            {
+                if (target > gain)
+                    gain = jmin(target, gain + step);
+                else if (positionInBlock + i >= fadeStart)
+                    gain = jmax(target, gain - step);
+
+                for (auto ch = 0; ch < numChannelsToUse; ++ch)
+                    output[ch][start + i] += getTailSlot(tailOutput, ch, block)[positionInBlock + i] * gain;
+            }
+
+            tailGain = gain;
+        }
+
+        static constexpr int numTailSlots = 4;
+
+        int numChannels = 2;
+        int headSize = 0, tailSize = 0;
+
+        PartitionedConvolver head[2], tail[2];
+
+        // numTailSlots blocks of tail input and output per channel: the audio thread fills one
+        // input block while an earlier one is being rendered, and reads one output block while a
+        // later one is written. The spare slots let the background thread run late safely.
+        HeapBlock<float> tailInput, tailOutput, tailScratch;
+
+        int64 samplePosition = 0;
+        float tailGain = 1.0f;
+        bool isTailBlockLeftOut = false;
+        std::atomic<int64> blocksAvailable { 0 }, blocksClaimed { 0 }, blocksDone { 0 };
+    };
+
+    //==============================================================================
+    void processChunk(float* const* channels, int numBlockChannels, int numSamples) noexcept
+    {
+        // Take a new engine if one is waiting, unless the last one hasn't been collected yet
+        Engine* fadingOut = nullptr;
+
+        if (retiredEngine.load(std::memory_order_acquire) == nullptr)
+        {
+            if (auto* newEngine = pendingEngine.exchange(nullptr, std::memory_order_acq_rel))
+            {
+                fadingOut = currentEngine;
+                currentEngine = newEngine;
+                activeEngine.store(currentEngine, std::memory_order_release);
+            }
+        }
+
+        auto* wet = wetBuffer.getArrayOfWritePointers();
+        auto numLate = 0;
+
+        if (currentEngine != nullptr)
+        {
+            numLate += currentEngine->process(channels, wet, numBlockChannels, numSamples, nonRealtime);
+        }
+        else
+        {
+            // No impulse response yet, so only the dry signal
+            for (auto ch = 0; ch < numBlockChannels; ++ch)
+                FloatVectorOperations::clear(wet[ch], numSamples);
+        }
+
+        if (fadingOut != nullptr)
+        {
+            auto* fade = fadeBuffer.getArrayOfWritePointers();
+            numLate += fadingOut->process(channels, fade, numBlockChannels, numSamples, nonRealtime);
+
+            for (auto ch = 0; ch < numBlockChannels; ++ch)
+            {
+                for (auto i = 0; i < numSamples; ++i)
+                {
+                    const auto alpha = (float)(i + 1) / (float)numSamples;
+                    wet[ch][i] = wet[ch][i] * alpha + fade[ch][i] * (1.0f - alpha);
+                }
+            }
+
+            retiredEngine.store(fadingOut, std::memory_order_release);
+        }
+
+        if (numLate > 0)
+            numLateTailBlocks.fetch_add(numLate, std::memory_order_relaxed);
+
+        for (auto i = 0; i < numSamples; ++i)
+        {
+            const auto dry = dryGain.getNextValue();
+            const auto wetLevel = wetGain.getNextValue();
+
+            for (auto ch = 0; ch < numBlockChannels; ++ch)
+                channels[ch][i] = channels[ch][i] * dry + wet[ch][i] * wetLevel;
+        }
+    }
+
+    // Reads and prepares the impulse responses that are asked for
+    void loadRequestedImpulseResponse()
+    {
+        File file;
+        AudioBuffer<float> buffer;
+        double bufferSampleRate = 0.0;
+
+        {
+            const ScopedLock sl(requestLock);
+
+            if (! hasRequest)
+                return;
+
+            file = requestedFile;
+            buffer.makeCopyOf(requestedBuffer);
+            bufferSampleRate = requestedSampleRate;
+            hasRequest = false;
+        }
+
+        if (file != File() && ! readFile(file, buffer, bufferSampleRate))
+            return;
+
+        if (buffer.getNumSamples() == 0 || bufferSampleRate <= 0.0)
+            return;
+
+        dsp::ProcessSpec spec;
+
+        {
+            const ScopedLock sl(requestLock);
+
+            impulseResponse.makeCopyOf(buffer);
+            impulseResponseSampleRate = bufferSampleRate;
+            impulseResponseFile = file;
+            spec = currentSpec;
+        }
+
+        // Not prepared yet, prepare() will build it
+        if (spec.sampleRate <= 0.0)
+            return;
+
+        // Replaces any engine the audio thread hasn't picked up yet
+        if (auto* unused = pendingEngine.exchange(new Engine(buffer, bufferSampleRate, spec), std::memory_order_acq_rel))
+            delete unused;
+    }
+
+    static bool readFile(const File& file, AudioBuffer<float>& buffer, double& fileSampleRate)
+    {
+        AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        ScopedPointer<AudioFormatReader> reader(formatManager.createReaderFor(file));
+
+        if (reader == nullptr)
+            return false;
+
+        const auto numSamples = (int)jmin(reader->lengthInSamples, (int64)(reader->sampleRate * maxLengthSeconds));
+
+        buffer.setSize(jmin(2, (int)reader->numChannels), numSamples);
+        reader->read(&buffer, 0, numSamples, 0, true, true);
+        fileSampleRate = reader->sampleRate;
+
+        return true;
+    }
+
+    void deleteRetiredEngine()
+    {
+        if (auto* retired = retiredEngine.exchange(nullptr, std::memory_order_acq_rel))
+            delete retired;
+    }
+
+    // Only while the threads are stopped
+    void deleteEngines()
+    {
+        deleteRetiredEngine();
+        delete pendingEngine.exchange(nullptr);
+
+        activeEngine.store(nullptr);
+        delete currentEngine;
+        currentEngine = nullptr;
+    }
+
+    void startThreads()
+    {
+        tailThread.startThread(tailThreadPriority);
+        loaderThread.startThread();
+    }
+
+    void stopThreads()
+    {
+        // Loading a long impulse response can take a while, and stopThread() kills a thread that
+        // doesn't finish in time
+        loaderThread.stopThread(10000);
+        tailThread.stopThread(1000);
+    }
+
+    // Renders tail blocks for the audio thread's current engine, and deletes the engines it has
+    // finished with. Deleting them here means an engine is never freed part way through a block.
+    struct TailThread : public Thread
+    {
+        TailThread(ConvolutionReverb& r) : Thread("Convolution reverb tail"), reverb(r) {}
+
+        void run() override
+        {
+            // The tail of a decaying reverb is full of denormals
+            ScopedNoDenormals noDenormals;
+
+            while (! threadShouldExit())
+            {
+                reverb.deleteRetiredEngine();
+
+                if (auto* engine = reverb.activeEngine.load(std::memory_order_acquire))
+                    if (engine->renderNextTailBlock())
+                        continue;
+
+                // The tail has at least a whole block's worth of time, several milliseconds, so
+                // polling is soon enough and keeps the audio thread from having to signal
+                wait(1);
+            }
+        }
+
+        ConvolutionReverb& reverb;
+    };
+
+    struct LoaderThread : public Thread
+    {
+        LoaderThread(ConvolutionReverb& r) : Thread("Convolution reverb loader"), reverb(r) {}
+
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                reverb.loadRequestedImpulseResponse();
+                wait(-1);
+            }
+        }
+
+        ConvolutionReverb& reverb;
+    };
+
+    static constexpr int tailThreadPriority = 8;
+    static constexpr double maxLengthSeconds = 20.0;
+
+    // Audio thread only
+    Engine* currentEngine = nullptr;
+
+    // Handed over between threads: the loading thread to the audio thread, the audio thread to
+    // the tail thread to render, and back to the tail thread to delete
+    std::atomic<Engine*> pendingEngine { nullptr }, activeEngine { nullptr }, retiredEngine { nullptr };
+
+    std::atomic<int> numLateTailBlocks { 0 };
+
+    int numChannels = 2, maximumBlockSize = 0;
+    AudioBuffer<float> wetBuffer, fadeBuffer;
+    LinearSmoothedValue<float> wetGain, dryGain;
+    bool enabled = true, nonRealtime = false;
+
+    // Guards the requests and the loaded impulse response, never taken by the audio thread
+    CriticalSection requestLock;
+    bool hasRequest = false;
+    File requestedFile;
+    AudioBuffer<float> requestedBuffer;
+    double requestedSampleRate = 0.0;
+
+    AudioBuffer<float> impulseResponse;
+    double impulseResponseSampleRate = 0.0;
+    File impulseResponseFile;
+    dsp::ProcessSpec currentSpec { 0.0, 0, 0 };
+
+    TailThread tailThread;
+    LoaderThread loaderThread;
+};
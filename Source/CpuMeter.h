@@ -0,0 +1,83 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "StageTimings.h"
+#include "QualityGovernor.h"
+
+// Shows how much of the real-time budget each stage of processBlock() used since the last update,
+// see StageTimings.h. The stages are stacked in one bar, where the full width is the whole budget,
+// with each stage's share, the voice counts and the number of blocks that ran late written
+// underneath. While the QualityGovernor has lowered the quality, the bar says how far.
+struct CpuMeter : public Component,
+                  public SettableTooltipClient
+{
+    // Call from a timer with the processor's latest timings
+    void update(const StageTimings::Snapshot& snapshot, int64 newNumLateBlocks, int newQualityLevel)
+    {
+        for (auto stage = 0; stage < StageTimings::numStages; ++stage)
+            loads[stage] = snapshot.getLoad(previous, stage);
+
+        numActiveVoices = snapshot.numActiveVoices;
+        numVoiceSteals = snapshot.numVoiceSteals;
+        numLateBlocks = newNumLateBlocks;
+        qualityLevel = newQualityLevel;
+        previous = snapshot;
+
+        repaint();
+    }
+
+    std::function<void()> onClick;
+
+    void mouseUp(const MouseEvent& event) override
+    {
+        if (onClick != nullptr && contains(event.getPosition()))
+            onClick();
+    }
+
+    void paint(Graphics& g) override
+    {
+        static const Colour colours[] = { Colours::lightblue, Colours::orange, Colours::yellowgreen,
+                                          Colours::mediumpurple, Colours::lightgrey };
+
+        auto bounds = getLocalBounds().toFloat();
+        auto bar = bounds.removeFromTop(bounds.getHeight() / 2).reduced(0.0f, 2.0f);
+
+        g.setColour(Colours::black.withAlpha(0.3f));
+        g.fillRect(bar);
+
+        auto x = bar.getX();
+        String text;
+
+        for (auto stage = 0; stage < StageTimings::numStages; ++stage)
+        {
+            const auto width = jmin(bar.getRight() - x, loads[stage] * bar.getWidth());
+
+            g.setColour(colours[stage]);
+            g.fillRect(x, bar.getY(), jmax(0.0f, width), bar.getHeight());
+            x += jmax(0.0f, width);
+
+            text << StageTimings::getStageName(stage) << " " << String(loads[stage] * 100.0f, 1) << "%  ";
+        }
+
+        if (qualityLevel != QualityGovernor::fullQuality)
+        {
+            g.setColour(Colours::orange);
+            g.setFont(9);
+            g.drawFittedText(String("Reduced to ") + QualityGovernor::getLevelName(qualityLevel),
+                             bar.reduced(3.0f, 0.0f).toNearestInt(), Justification::centredRight, 1, 0.6f);
+        }
+
+        text << numActiveVoices << " voices, " << numVoiceSteals << " stolen, " << numLateBlocks << " late";
+
+        // Squashed rather than cut off when the editor is narrow
+        g.setColour(Colours::white);
+        g.setFont(10);
+        g.drawFittedText(text, bounds.toNearestInt(), Justification::centredLeft, 1, 0.6f);
+    }
+
+private:
+    StageTimings::Snapshot previous;
+    float loads[StageTimings::numStages] = {};
+    int numActiveVoices = 0, qualityLevel = QualityGovernor::fullQuality;
+    int64 numVoiceSteals = 0, numLateBlocks = 0;
+};
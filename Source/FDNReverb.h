@@ -0,0 +1,541 @@
+#pragma once
+
+// A feedback delay network reverb: 8 or 16 delay lines whose outputs are damped, scaled for the
+// decay time and mixed back into their inputs through an orthogonal matrix. Every line feeds
+// every other one, so the echo density builds up much faster than with Freeverb's parallel
+// combs, and it takes the same Reverb::Parameters as the other reverbs:
+//
+//  - roomSize sets the decay time (RT60) from 0.3 to 9 seconds. Each line's gain is set from its
+//    length so that all of them decay at the same rate.
+//  - damping is a one-pole lowpass in each line, so high frequencies die away sooner.
+//  - width, wetLevel, dryLevel and freezeMode work like they do in Reverb.
+//
+// The feedback matrix is a Householder reflection, I - 2/8 * ones, over each group of 8 lines.
+// With 16 lines the two groups are then combined with a 2x2 Hadamard matrix, a rotation by 45
+// degrees. Both are orthogonal, so the network is lossless apart from the gains and damping.
+// Each costs a sum and a multiply-add per line rather than a full matrix-vector product, and the
+// lines are held in dsp::SIMDRegisters, so a frame of 8 lines is one AVX register or two SSE/NEON
+// ones.
+//
+// All the lines live in one block of memory, each starting on its own cache line. Like
+// SIMDReverb, the network runs in sub-blocks no longer than the shortest line, so each line's
+// delayed samples for a sub-block are read as one contiguous run into a staging area, the
+// network runs frame by frame on that, and the new samples are written back the same way.
+//
+// The quality sets the number of lines, which is most of the cost. The two groups take alternate
+// line lengths, so either way the lines cover the whole range, and the low quality is the first
+// group on its own with the same weights. Going down to it, the rotation between the groups
+// eases back to none while the second group's output fades out over qualityFadeSeconds, so the
+// first group's tail carries on without a click. Going back up, the second group's lines are
+// cleared and faded in the same way.
+struct FDNReverb
+{
+    using Vector = dsp::SIMDRegister<float>;
+    using Parameters = Reverb::Parameters;
+
+    enum class Quality
+    {
+        low,    // 8 lines
+        high    // 16 lines
+    };
+
+    static constexpr int numLanes = (int)Vector::SIMDNumElements;
+    static constexpr int linesPerGroup = 8;
+    static constexpr int maxLines = 16;
+    static constexpr int vectorsPerGroup = linesPerGroup / numLanes;
+    static constexpr int maxVectors = maxLines / numLanes;
+    static constexpr int maxSubBlockSize = 64;
+    static constexpr double qualityFadeSeconds = 0.1;
+
+    static_assert(linesPerGroup % numLanes == 0, "Each register must hold lines from only one group");
+
+    FDNReverb()
+    {
+        workStorage.calloc((size_t)(numWorkValues + numLanes));
+        auto* work = Vector::getNextSIMDAlignedPtr(workStorage.get());
+
+        staged        = work;
+        lowpassState  = staged + maxSubBlockSize * maxLines;
+        lineGains     = lowpassState + maxLines;
+        inputWeights  = lineGains + maxLines;
+        leftWeights   = inputWeights + maxLines;
+        rightWeights  = leftWeights + maxLines;
+        combinedInput = rightWeights + maxLines;
+        wet[0]        = combinedInput + maxSubBlockSize;
+        wet[1]        = wet[0] + maxSubBlockSize;
+
+        setParameters(Parameters());
+        setSampleRate(44100.0);
+    }
+
+    //==============================================================================
+    const Parameters& getParameters() const noexcept
+    {
+        return parameters;
+    }
+
+    void setParameters(const Parameters& newParams) noexcept
+    {
+        const auto wetLevel = newParams.wetLevel * wetScaleFactor;
+        dryGain.setValue(newParams.dryLevel * 2.0f);
+        wetGain1.setValue(0.5f * wetLevel * (1.0f + newParams.width));
+        wetGain2.setValue(0.5f * wetLevel * (1.0f - newParams.width));
+
+        if (newParams.freezeMode >= 0.5f)
+        {
+            decayTime = std::numeric_limits<float>::infinity();
+            inputGain = 0.0f;
+            decayRate.setValue(0.0f);
+            damping.setValue(0.0f);
+        }
+        else
+        {
+            // -60 dB per RT60 seconds, as a log gain per sample
+            decayTime = 0.3f * std::pow(30.0f, newParams.roomSize);
+
+            inputGain = 1.0f;
+            decayRate.setValue(-6.9077553f / (decayTime * sampleRate));
+            damping.setValue(newParams.damping * 0.7f);
+        }
+
+        parameters = newParams;
+    }
+
+    // The decay time plus the longest line, after which the tail is 60 dB down. Infinite while
+    // frozen.
+    double getTailLengthSeconds() const noexcept
+    {
+        return (double)decayTime + maxLineLengths[maxLines - 1] / (double)sampleRate;
+    }
+
+    Quality getQuality() const noexcept
+    {
+        return quality;
+    }
+
+    // Can be called from the audio thread. The change fades in over qualityFadeSeconds.
+    void setQuality(Quality newQuality) noexcept
+    {
+        if (quality == newQuality)
+            return;
+
+        quality = newQuality;
+
+        // The second group has been standing still since it last faded out, so it starts again
+        // from silence
+        if (quality == Quality::high && secondGroupLevel == 0.0f)
+            clearSecondGroup();
+    }
+
+    // Allocates the delay lines, so call this before processing rather than from it
+    void setSampleRate(double newSampleRate)
+    {
+        jassert(newSampleRate > 0);
+
+        sampleRate = (float)newSampleRate;
+
+        // Each line starts on a cache line of its own
+        const auto lineAlignment = 16;
+        auto totalSize = 0;
+
+        for (auto i = 0; i < maxLines; ++i)
+        {
+            // Spread geometrically between 30 and 69 ms, rounded to primes so that no two lines
+            // share a common period
+            const auto lengthMs = 30.0 * std::pow(2.3, i / (double)(maxLines - 1));
+            maxLineLengths[i] = nextPrime(jmax(2, roundToInt(lengthMs * 0.001 * newSampleRate)));
+
+            lineStarts[i] = totalSize;
+            totalSize += (maxLineLengths[i] + lineAlignment - 1) / lineAlignment * lineAlignment;
+        }
+
+        delayStorage.calloc((size_t)(totalSize + lineAlignment));
+        delayLines = Vector::getNextSIMDAlignedPtr(delayStorage.get());
+        delayStorageSize = totalSize;
+
+        const auto smoothTime = 0.01;
+        decayRate.reset(newSampleRate, smoothTime);
+        damping  .reset(newSampleRate, smoothTime);
+        dryGain  .reset(newSampleRate, smoothTime);
+        wetGain1 .reset(newSampleRate, smoothTime);
+        wetGain2 .reset(newSampleRate, smoothTime);
+
+        setParameters(parameters);
+        updateLayout();
+        reset();
+    }
+
+    // Clears the tail, and finishes any change of quality straight away
+    void reset() noexcept
+    {
+        FloatVectorOperations::clear(delayLines, delayStorageSize);
+        FloatVectorOperations::clear(lowpassState, maxLines);
+
+        for (auto& position : linePositions)
+            position = 0;
+
+        secondGroupLevel = quality == Quality::high ? 1.0f : 0.0f;
+        updateWeights();
+
+        currentDecayRate = 1.0f; // forces the gains to be worked out
+    }
+
+    void processStereo(float* left, float* right, int numSamples) noexcept
+    {
+        jassert(left != nullptr && right != nullptr);
+        process(left, right, numSamples);
+    }
+
+    void processMono(float* samples, int numSamples) noexcept
+    {
+        jassert(samples != nullptr);
+        process(samples, nullptr, numSamples);
+    }
+
+    //==============================================================================
+    // The same interface as dsp::Reverb
+    bool isEnabled() const noexcept
+    {
+        return enabled;
+    }
+
+    void setEnabled(bool newValue) noexcept
+    {
+        enabled = newValue;
+    }
+
+    void prepare(const dsp::ProcessSpec& spec)
+    {
+        setSampleRate(spec.sampleRate);
+    }
+
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        const auto& inputBlock = context.getInputBlock();
+        auto& outputBlock = context.getOutputBlock();
+        const auto numInChannels = inputBlock.getNumChannels();
+        const auto numOutChannels = outputBlock.getNumChannels();
+        const auto numSamples = (int)outputBlock.getNumSamples();
+
+        jassert(inputBlock.getNumSamples() == (size_t)numSamples);
+
+        outputBlock.copy(inputBlock);
+
+        if (! enabled || context.isBypassed)
+            return;
+
+        if (numInChannels == 1 && numOutChannels == 1)
+            processMono(outputBlock.getChannelPointer(0), numSamples);
+        else if (numInChannels == 2 && numOutChannels == 2)
+            processStereo(outputBlock.getChannelPointer(0), outputBlock.getChannelPointer(1), numSamples);
+        else
+            jassertfalse; // invalid channel configuration
+    }
+
+private:
+    static constexpr int numWorkValues = maxSubBlockSize * (maxLines + 3) + maxLines * 5;
+
+    // Keeps the level of the wet signal close to Reverb's with the same settings
+    static constexpr float wetScaleFactor = 1.25f;
+
+    static int nextPrime(int n) noexcept
+    {
+        for (;; ++n)
+        {
+            auto isPrime = n > 1;
+
+            for (auto divisor = 2; isPrime && divisor * divisor <= n; ++divisor)
+                isPrime = n % divisor != 0;
+
+            if (isPrime)
+                return n;
+        }
+    }
+
+    // Shares the line lengths out between the two groups: the first group gets the even ones
+    // and the second the odd ones
+    void updateLayout() noexcept
+    {
+        for (auto i = 0; i < maxLines; ++i)
+        {
+            const auto lengthIndex = i < linesPerGroup ? i * 2 : (i - linesPerGroup) * 2 + 1;
+
+            lineLengths[i] = maxLineLengths[lengthIndex];
+            activeLineStarts[i] = lineStarts[lengthIndex];
+        }
+
+        subBlockSize = jmin(maxSubBlockSize, lineLengths[0]);
+    }
+
+    // Works out the weights and the rotation between the groups for the second group's current
+    // level, which is 1 at high quality and 0 at low
+    void updateWeights() noexcept
+    {
+        // Signs for spreading the input over the lines and taking the two outputs from them.
+        // They are mutually orthogonal and none is all the same sign, which the Householder
+        // matrix would only reflect.
+        static const float inputSigns[] = { 1, -1, 1, 1, -1, 1, -1, -1,   1, 1, -1, 1, -1, -1, -1, 1 };
+        static const float leftSigns[]  = { 1, 1, -1, -1, 1, 1, -1, -1,   1, 1, -1, -1, 1, 1, -1, -1 };
+        static const float rightSigns[] = { 1, -1, -1, 1, 1, -1, -1, 1,   -1, 1, 1, -1, -1, 1, 1, -1 };
+
+        const auto level = secondGroupLevel;
+        numLines = level > 0.0f ? maxLines : linesPerGroup;
+
+        // Scaling only the input keeps the wet level the same whatever the number of lines
+        const auto scale = 1.0f / std::sqrt((float)linesPerGroup * (1.0f + level));
+
+        for (auto i = 0; i < maxLines; ++i)
+        {
+            const auto weight = i < linesPerGroup ? 1.0f : level;
+
+            inputWeights[i] = inputSigns[i] * scale * weight;
+            leftWeights[i]  = leftSigns[i] * weight;
+            rightWeights[i] = rightSigns[i] * weight;
+        }
+
+        const auto angle = level * MathConstants<float>::pi * 0.25f;
+        rotationCos = std::cos(angle);
+        rotationSin = std::sin(angle);
+    }
+
+    // Moves the second group's level on towards the quality, once per sub-block
+    void updateQualityFade(int numSamples) noexcept
+    {
+        const auto target = quality == Quality::high ? 1.0f : 0.0f;
+
+        if (secondGroupLevel == target)
+            return;
+
+        const auto step = (float)numSamples / (float)(qualityFadeSeconds * sampleRate);
+        secondGroupLevel = target > secondGroupLevel ? jmin(target, secondGroupLevel + step)
+                                                     : jmax(target, secondGroupLevel - step);
+
+        const auto previousNumLines = numLines;
+        updateWeights();
+
+        if (numLines != previousNumLines)
+            currentDecayRate = 1.0f; // the second group's gains need working out
+    }
+
+    void clearSecondGroup() noexcept
+    {
+        for (auto line = linesPerGroup; line < maxLines; ++line)
+        {
+            FloatVectorOperations::clear(delayLines + activeLineStarts[line], lineLengths[line]);
+            linePositions[line] = 0;
+            lowpassState[line] = 0.0f;
+        }
+    }
+
+    // A null right channel means mono, which only uses the left output
+    void process(float* left, float* right, int numSamples) noexcept
+    {
+        ScopedNoDenormals noDenormals;
+
+        for (auto start = 0; start < numSamples; start += subBlockSize)
+            processSubBlock(left + start, right != nullptr ? right + start : nullptr,
+                            jmin(subBlockSize, numSamples - start));
+    }
+
+    void processSubBlock(float* left, float* right, int numSamples) noexcept
+    {
+        updateQualityFade(numSamples);
+        updateLineGains(numSamples);
+
+        const auto damp = damping.getNextValue();
+        damping.skip(numSamples - 1);
+
+        for (auto i = 0; i < numSamples; ++i)
+            combinedInput[i] = (right != nullptr ? left[i] + right[i] : left[i]) * inputGain;
+
+        for (auto line = 0; line < numLines; ++line)
+            readLine(line, numSamples);
+
+        const auto numVectors = numLines / numLanes;
+        const auto numGroups = numLines / linesPerGroup;
+        const auto undamped = 1.0f - damp;
+        const auto householderScale = -2.0f / linesPerGroup;
+        const auto c = rotationCos, s = rotationSin;
+
+        Vector lowpass[maxVectors], gains[maxVectors], inputs[maxVectors], lefts[maxVectors], rights[maxVectors];
+
+        for (auto v = 0; v < numVectors; ++v)
+        {
+            lowpass[v] = Vector::fromRawArray(lowpassState + v * numLanes);
+            gains[v]   = Vector::fromRawArray(lineGains + v * numLanes);
+            inputs[v]  = Vector::fromRawArray(inputWeights + v * numLanes);
+            lefts[v]   = Vector::fromRawArray(leftWeights + v * numLanes);
+            rights[v]  = Vector::fromRawArray(rightWeights + v * numLanes);
+        }
+
+        for (auto i = 0; i < numSamples; ++i)
+        {
+            auto* frame = staged + i * maxLines;
+
+            Vector x[maxVectors];
+            auto sumLeft = Vector::expand(0.0f), sumRight = Vector::expand(0.0f);
+
+            for (auto v = 0; v < numVectors; ++v)
+            {
+                lowpass[v] = Vector::fromRawArray(frame + v * numLanes) * undamped + lowpass[v] * damp;
+                x[v] = lowpass[v] * gains[v];
+
+                sumLeft  = Vector::multiplyAdd(sumLeft,  x[v], lefts[v]);
+                sumRight = Vector::multiplyAdd(sumRight, x[v], rights[v]);
+            }
+
+            wet[0][i] = sumLeft.sum();
+            wet[1][i] = sumRight.sum();
+
+            // Householder reflection within each group of 8 lines
+            for (auto group = 0; group < numGroups; ++group)
+            {
+                auto* groupVectors = x + group * vectorsPerGroup;
+                auto groupSum = groupVectors[0];
+
+                for (auto v = 1; v < vectorsPerGroup; ++v)
+                    groupSum += groupVectors[v];
+
+                const auto reflection = Vector::expand(groupSum.sum() * householderScale);
+
+                for (auto v = 0; v < vectorsPerGroup; ++v)
+                    groupVectors[v] += reflection;
+            }
+
+            // Hadamard across the two groups, or less of a rotation while the quality changes
+            if (numGroups == 2)
+            {
+                for (auto v = 0; v < vectorsPerGroup; ++v)
+                {
+                    const auto a = x[v], b = x[v + vectorsPerGroup];
+
+                    x[v]                   = a * c + b * s;
+                    x[v + vectorsPerGroup] = a * s - b * c;
+                }
+            }
+
+            const auto input = combinedInput[i];
+
+            for (auto v = 0; v < numVectors; ++v)
+                (x[v] + inputs[v] * input).copyToRawArray(frame + v * numLanes);
+        }
+
+        for (auto v = 0; v < numVectors; ++v)
+            lowpass[v].copyToRawArray(lowpassState + v * numLanes);
+
+        for (auto line = 0; line < numLines; ++line)
+            writeLine(line, numSamples);
+
+        if (right == nullptr)
+        {
+            for (auto i = 0; i < numSamples; ++i)
+            {
+                const auto dry  = dryGain.getNextValue();
+                const auto wet1 = wetGain1.getNextValue();
+
+                left[i] = wet[0][i] * wet1 + left[i] * dry;
+            }
+
+            return;
+        }
+
+        for (auto i = 0; i < numSamples; ++i)
+        {
+            const auto dry  = dryGain.getNextValue();
+            const auto wet1 = wetGain1.getNextValue();
+            const auto wet2 = wetGain2.getNextValue();
+
+            const auto outL = wet[0][i], outR = wet[1][i];
+
+            left[i]  = outL * wet1 + outR * wet2 + left[i]  * dry;
+            right[i] = outR * wet1 + outL * wet2 + right[i] * dry;
+        }
+    }
+
+    // The gains only need working out again while the decay time is changing
+    void updateLineGains(int numSamples) noexcept
+    {
+        const auto rate = decayRate.getNextValue();
+        decayRate.skip(numSamples - 1);
+
+        if (rate == currentDecayRate)
+            return;
+
+        currentDecayRate = rate;
+
+        for (auto i = 0; i < numLines; ++i)
+            lineGains[i] = std::exp(rate * (float)lineLengths[i]);
+    }
+
+    // Copies the line's next numSamples delayed values into its lane of the staging area
+    void readLine(int line, int numSamples) noexcept
+    {
+        const auto* buffer = delayLines + activeLineStarts[line];
+        const auto position = linePositions[line];
+        const auto numBeforeWrap = jmin(numSamples, lineLengths[line] - position);
+
+        for (auto i = 0; i < numBeforeWrap; ++i)
+            staged[i * maxLines + line] = buffer[position + i];
+
+        for (auto i = numBeforeWrap; i < numSamples; ++i)
+            staged[i * maxLines + line] = buffer[i - numBeforeWrap];
+    }
+
+    // Stores the values left in the line's lane back in the same places, and moves the line on
+    void writeLine(int line, int numSamples) noexcept
+    {
+        auto* buffer = delayLines + activeLineStarts[line];
+        auto& position = linePositions[line];
+        const auto numBeforeWrap = jmin(numSamples, lineLengths[line] - position);
+
+        for (auto i = 0; i < numBeforeWrap; ++i)
+            buffer[position + i] = staged[i * maxLines + line];
+
+        for (auto i = numBeforeWrap; i < numSamples; ++i)
+            buffer[i - numBeforeWrap] = staged[i * maxLines + line];
+
+        position = numBeforeWrap < numSamples ? numSamples - numBeforeWrap
+                                              : position + numSamples;
+
+        if (position == lineLengths[line])
+            position = 0;
+    }
+
+    Parameters parameters;
+    Quality quality = Quality::high;
+    int numLines = maxLines;
+    float sampleRate = 44100.0f;
+    float inputGain = 1.0f;
+    float decayTime = 0.0f;
+    float currentDecayRate = 1.0f;
+
+    // 1 while both groups run, 0 once the second has faded out
+    float secondGroupLevel = 1.0f;
+    float rotationCos = 0.70710678f, rotationSin = 0.70710678f;
+
+    // The delay lines, one after the other in a single allocation
+    HeapBlock<float> delayStorage;
+    float* delayLines = nullptr;
+    int delayStorageSize = 0;
+
+    int maxLineLengths[maxLines] = {}, lineStarts[maxLines] = {};
+    int lineLengths[maxLines] = {}, activeLineStarts[maxLines] = {}, linePositions[maxLines] = {};
+    int subBlockSize = maxSubBlockSize;
+
+    // The staging frames, the per-line state and weights, and the per-sample values of one
+    // sub-block. Kept on the heap so they are aligned for SIMD loads even when the reverb isn't.
+    HeapBlock<float> workStorage;
+    float* staged = nullptr;
+    float* lowpassState = nullptr;
+    float* lineGains = nullptr;
+    float* inputWeights = nullptr;
+    float* leftWeights = nullptr;
+    float* rightWeights = nullptr;
+    float* combinedInput = nullptr;
+    float* wet[2] = {};
+
+    LinearSmoothedValue<float> decayRate, damping, dryGain, wetGain1, wetGain2;
+
+    bool enabled = true;
+};
@@ -0,0 +1,675 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Synth.h"
+#include "SIMDLadderFilter.h"
+#include "SIMDReverb.h"
+#include "FDNReverb.h"
+#include "ConvolutionReverb.h"
+
+#include <chrono>
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+// Times the inner loops of the synth one at a time, away from the rest of processBlock(), so a
+// change to one kernel can be judged on its own. This is what "BasicSynthBenchmark --kernels"
+// runs, see BenchmarkMain.cpp; ProcessBlockBenchmark.h covers the whole chain.
+//
+// Each kernel owns everything it touches and processes one block per run. It is run a number of
+// times untimed to warm up, then each run is timed on its own, in two variants:
+//
+//  - hot: runs follow straight on from each other, so the kernel's state, tables and buffers are
+//    already in the caches, as they are when the synth has the core to itself
+//  - cold: every cache line of a buffer larger than the last level cache is written before each
+//    run, so everything the kernel touches comes from memory, as it does when a host has run
+//    other plugins on the core since the last block
+//
+// The results are the minimum, median, mean, 99th percentile and standard deviation of the time
+// per sample, in nanoseconds and in cycles. Cycles are read from the time stamp counter on x86,
+// which ticks at the processor's base frequency rather than its current one, so they are only
+// comparable between runs at the same clock settings. Elsewhere they are reported as 0.
+//
+// The kernels run with denormals flushed to zero, as they do in processBlock(), except for the
+// one that measures what happens without.
+struct KernelBenchmark
+{
+    static constexpr int blockSize = 512;
+    static constexpr double sampleRate = 48000.0;
+
+    // One piece of DSP code and everything it needs. run() processes one block and must not
+    // allocate.
+    struct Kernel
+    {
+        Kernel(const String& kernelName, int samplesPerRun) : name(kernelName), numSamples(samplesPerRun) {}
+        virtual ~Kernel() {}
+
+        virtual void run() noexcept = 0;
+
+        const String name;
+        const int numSamples;
+        bool flushDenormals = true;
+    };
+
+    struct Statistics
+    {
+        double min = 0.0, median = 0.0, mean = 0.0, p99 = 0.0, standardDeviation = 0.0;
+
+        // Sorts the values
+        static Statistics fromValues(double* values, int numValues)
+        {
+            std::sort(values, values + numValues);
+
+            Statistics statistics;
+            statistics.min = values[0];
+            statistics.median = values[numValues / 2];
+            statistics.p99 = values[jmin(numValues - 1, (numValues * 99) / 100)];
+
+            for (auto i = 0; i < numValues; ++i)
+                statistics.mean += values[i];
+
+            statistics.mean /= numValues;
+
+            for (auto i = 0; i < numValues; ++i)
+                statistics.standardDeviation += square(values[i] - statistics.mean);
+
+            statistics.standardDeviation = std::sqrt(statistics.standardDeviation / numValues);
+            return statistics;
+        }
+
+        var toVar() const
+        {
+            auto* object = new DynamicObject();
+
+            object->setProperty("min", min);
+            object->setProperty("median", median);
+            object->setProperty("mean", mean);
+            object->setProperty("p99", p99);
+            object->setProperty("stdDev", standardDeviation);
+
+            return var(object);
+        }
+    };
+
+    struct Result
+    {
+        String name;
+        bool coldCache = false;
+        int samplesPerRun = 0, numRuns = 0;
+        Statistics nsPerSample, cyclesPerSample;
+
+        var toVar() const
+        {
+            auto* object = new DynamicObject();
+
+            object->setProperty("name", name);
+            object->setProperty("cache", coldCache ? "cold" : "hot");
+            object->setProperty("samplesPerRun", samplesPerRun);
+            object->setProperty("runs", numRuns);
+            object->setProperty("nsPerSample", nsPerSample.toVar());
+            object->setProperty("cyclesPerSample", cyclesPerSample.toVar());
+
+            return var(object);
+        }
+    };
+
+    int numWarmUpRuns = 100;
+    int numHotRuns = 2000;
+    int numColdRuns = 200;
+
+    // Larger than the last level cache of any desktop processor
+    static constexpr size_t evictionBufferSize = 64 * 1024 * 1024;
+
+    Result measure(Kernel& kernel, bool coldCache)
+    {
+        const auto numRuns = coldCache ? numColdRuns : numHotRuns;
+
+        HeapBlock<double> ns((size_t)numRuns), cycles((size_t)numRuns);
+
+        if (coldCache && evictionBuffer == nullptr)
+            evictionBuffer.calloc(evictionBufferSize);
+
+        {
+            const ScopedFlushDenormals flush(kernel.flushDenormals);
+
+            for (auto i = 0; i < numWarmUpRuns; ++i)
+                kernel.run();
+
+            for (auto i = 0; i < numRuns; ++i)
+            {
+                if (coldCache)
+                    evictCaches();
+
+                // Time::getHighResolutionTicks() counts microseconds on Linux, which is about as
+                // long as a hot run takes, so this uses the nanosecond clock instead
+                const auto startCycles = readCycleCounter();
+                const auto startTime = std::chrono::steady_clock::now();
+
+                kernel.run();
+
+                const auto endTime = std::chrono::steady_clock::now();
+                const auto endCycles = readCycleCounter();
+
+                ns[i] = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count()
+                          / kernel.numSamples;
+                cycles[i] = (double)(endCycles - startCycles) / kernel.numSamples;
+            }
+        }
+
+        Result result;
+        result.name = kernel.name;
+        result.coldCache = coldCache;
+        result.samplesPerRun = kernel.numSamples;
+        result.numRuns = numRuns;
+        result.nsPerSample = Statistics::fromValues(ns, numRuns);
+        result.cyclesPerSample = Statistics::fromValues(cycles, numRuns);
+
+        return result;
+    }
+
+    static bool hasCycleCounter() noexcept
+    {
+       #if JUCE_INTEL
+        return true;
+       #else
+        return false;
+       #endif
+    }
+
+    static uint64 readCycleCounter() noexcept
+    {
+       #if JUCE_INTEL
+        return (uint64)__rdtsc();
+       #else
+        return 0;
+       #endif
+    }
+
+    static var toVar(const Array<Result>& results)
+    {
+        Array<var> list;
+
+        for (auto& result : results)
+            list.add(result.toVar());
+
+        auto* object = new DynamicObject();
+        object->setProperty("cpu", SystemStats::getCpuModel());
+        object->setProperty("cycleCounter", hasCycleCounter() ? "tsc" : "none");
+        object->setProperty("blockSize", blockSize);
+        object->setProperty("sampleRate", sampleRate);
+        object->setProperty("results", list);
+
+        return var(object);
+    }
+
+    //==============================================================================
+    // The kernels
+
+    // One voice on its own, with the sine table at a given size
+    struct VoiceKernel : public Kernel
+    {
+        VoiceKernel(int tableSizeLog2)
+            : Kernel("voice/renderNextBlock/table" + String(1 << tableSizeLog2), blockSize)
+        {
+            table.initialise(tableSizeLog2);
+
+            voice.prepare(blockSize);
+            voice.setCurrentPlaybackSampleRate(sampleRate);
+            voice.startNote(69, 1.0f, nullptr, 0);
+        }
+
+        // The voice adds to the output, which never grows past a few times full scale since
+        // the phase carries on from run to run
+        void run() noexcept override
+        {
+            voice.renderNextBlock(output, 0, blockSize);
+        }
+
+        SineTable table;
+        SineWaveVoice voice { table, 0 };
+        AudioBuffer<float> output { 2, blockSize };
+    };
+
+    // The loop SineWaveVoice had before the sine table, for comparison: std::sin in double
+    // precision for every sample, added to each channel
+    struct StdSinVoiceKernel : public Kernel
+    {
+        StdSinVoiceKernel() : Kernel("voice/renderNextBlock/stdSin", blockSize)
+        {
+            angleDelta = MidiMessage::getMidiNoteInHertz(69) / sampleRate * MathConstants<double>::twoPi;
+        }
+
+        void run() noexcept override
+        {
+            for (auto i = 0; i < blockSize; ++i)
+            {
+                const auto currentSample = (float)(std::sin(currentAngle) * level);
+
+                for (auto ch = output.getNumChannels(); --ch >= 0;)
+                    output.addSample(ch, i, currentSample);
+
+                currentAngle += angleDelta;
+            }
+
+            // The old voice never wrapped its angle, but a note only lasts so long, and std::sin
+            // slows down once the angle is huge
+            currentAngle = std::fmod(currentAngle, MathConstants<double>::twoPi);
+        }
+
+        double currentAngle = 0.0, angleDelta = 0.0, level = 0.15;
+        AudioBuffer<float> output { 2, blockSize };
+    };
+
+    // The voices through SineWaveSynth, with the SIMD voice bank or rendering each voice on its
+    // own, render threads, and MIDI events that split the block
+    struct SynthKernel : public Kernel
+    {
+        SynthKernel(int numVoices, bool useVoiceBank, int numRenderThreads, int numEventsPerBlock)
+            : Kernel("synth/voices" + String(numVoices) + (useVoiceBank ? "/bank" : "/perVoice")
+                     + "/threads" + String(numRenderThreads) + "/events" + String(numEventsPerBlock),
+                     blockSize)
+        {
+            synth.addSound(new SineWaveSound());
+            synth.setPolyphony(numVoices);
+            synth.setVoiceBankEnabled(useVoiceBank);
+            synth.setNumRenderThreads(numRenderThreads);
+            synth.setCurrentPlaybackSampleRate(sampleRate);
+            synth.prepare(blockSize);
+
+            for (auto i = 0; i < numVoices; ++i)
+                synth.noteOn(1, getNoteNumber(i), 0.8f);
+
+            // Each event retriggers one of the notes, so the number of voices stays the same
+            for (auto i = 0; i < numEventsPerBlock; ++i)
+            {
+                const auto noteNumber = getNoteNumber(i % numVoices);
+                const auto position = (i * blockSize) / numEventsPerBlock;
+
+                midi.addEvent(MidiMessage::noteOff(1, noteNumber), position);
+                midi.addEvent(MidiMessage::noteOn(1, noteNumber, 0.8f), position);
+            }
+        }
+
+        void run() noexcept override
+        {
+            synth.renderNextBlock(output, midi, 0, blockSize);
+        }
+
+        static int getNoteNumber(int voice) noexcept
+        {
+            return 12 + (voice * 7) % 96;
+        }
+
+        SineTable table;
+        SineWaveSynth synth { table };
+        MidiBuffer midi;
+        AudioBuffer<float> output { 2, blockSize };
+    };
+
+    // Just the loop Synthesiser::processNextBlock() uses to read the events of a block
+    struct MidiIterationKernel : public Kernel
+    {
+        MidiIterationKernel(int numEventsPerBlock)
+            : Kernel("midi/iterate/events" + String(numEventsPerBlock), blockSize)
+        {
+            for (auto i = 0; i < numEventsPerBlock; ++i)
+                midi.addEvent(MidiMessage::noteOn(1, 60 + i % 12, 0.8f), (i * blockSize) / numEventsPerBlock);
+        }
+
+        void run() noexcept override
+        {
+            MidiBuffer::Iterator iterator(midi);
+            iterator.setNextSamplePosition(0);
+
+            MidiMessage message;
+            int position;
+
+            while (iterator.getNextEvent(message, position))
+                total += position + message.getNoteNumber();
+        }
+
+        MidiBuffer midi;
+        int64 total = 0;
+    };
+
+    // Gives the benchmark the per-sample function that dsp::LadderFilter::process() calls, and
+    // the function process() calls first to update the coefficients
+    struct LadderFilterAccess : public dsp::LadderFilter<float>
+    {
+        using dsp::LadderFilter<float>::processSample;
+        using dsp::LadderFilter<float>::updateSmoothers;
+    };
+
+    enum class LadderVariant
+    {
+        processSample,
+        process,
+        simd,
+        oversampled,
+        denormals,
+        denormalsFlushed
+    };
+
+    using OversamplingType = dsp::Oversampling<float>::FilterType;
+
+    // The filter on its own. The processSample, process and simd variants can be given any number
+    // of channels, the SIMD one using as many SIMDLadderFilters as it takes to hold them all. The
+    // oversampled variant runs process() inside dsp::Oversampling, as BasicSynth does with filter
+    // oversampling on, by 2^oversamplingFactorLog2 with either of its filters.
+    struct LadderKernel : public Kernel
+    {
+        LadderKernel(LadderVariant ladderVariant, int numChannelsToUse = 2, int oversamplingFactorLog2 = 2,
+                     OversamplingType oversamplingType = OversamplingType::filterHalfBandPolyphaseIIR)
+            : Kernel(getKernelName(ladderVariant, numChannelsToUse, oversamplingFactorLog2, oversamplingType), blockSize),
+              variant(ladderVariant), numChannels(numChannelsToUse)
+        {
+            auto spec = dsp::ProcessSpec { sampleRate, (uint32)blockSize, (uint32)numChannels };
+
+            if (variant == LadderVariant::oversampled)
+            {
+                oversampling = new dsp::Oversampling<float>((size_t)numChannels, (size_t)oversamplingFactorLog2, oversamplingType);
+                oversampling->initProcessing(blockSize);
+
+                spec.sampleRate *= (double)oversampling->getOversamplingFactor();
+                spec.maximumBlockSize *= (uint32)oversampling->getOversamplingFactor();
+            }
+
+            filter.prepare(spec);
+            filter.setMode(dsp::LadderFilter<float>::Mode::LPF24);
+            filter.setCutoffFrequencyHz(2000.0f);
+            filter.setResonance(0.5f);
+            filter.setDrive(2.0f);
+
+            // Jumps straight to the settings, which processSample() on its own never would
+            filter.reset();
+            filter.updateSmoothers();
+
+            for (auto firstChannel = 0; firstChannel < numChannels; firstChannel += SIMDLadderFilter::numLanes)
+            {
+                auto simdSpec = spec;
+                simdSpec.numChannels = (uint32)jmin(SIMDLadderFilter::numLanes, numChannels - firstChannel);
+
+                auto* simdFilter = simdFilters.add(new SIMDLadderFilter());
+                simdFilter->prepare(simdSpec);
+                simdFilter->setMode(dsp::LadderFilter<float>::Mode::LPF24);
+                simdFilter->setCutoffFrequencyHz(2000.0f);
+                simdFilter->setResonance(0.5f);
+                simdFilter->setDrive(2.0f);
+            }
+
+            input.setSize(numChannels, blockSize);
+            buffer.setSize(numChannels, blockSize);
+
+            // The denormal variants feed the filter a signal far below the smallest normal float,
+            // so its whole state is denormal, as it is while a filter rings down to silence
+            Random random(1);
+
+            for (auto ch = 0; ch < input.getNumChannels(); ++ch)
+                for (auto i = 0; i < blockSize; ++i)
+                    input.setSample(ch, i, (random.nextFloat() - 0.5f)
+                                             * (isDenormalVariant() ? 1.0e-39f : 1.0f));
+
+            flushDenormals = variant != LadderVariant::denormals;
+        }
+
+        void run() noexcept override
+        {
+            buffer.makeCopyOf(input, true);
+            dsp::AudioBlock<float> block(buffer);
+
+            switch (variant)
+            {
+                case LadderVariant::processSample:
+                    for (auto i = 0; i < blockSize; ++i)
+                        for (size_t ch = 0; ch < (size_t)numChannels; ++ch)
+                            block.getChannelPointer(ch)[i] = filter.processSample(block.getChannelPointer(ch)[i], ch);
+                    break;
+
+                case LadderVariant::simd:
+                    for (auto i = 0; i < simdFilters.size(); ++i)
+                    {
+                        auto* simdFilter = simdFilters.getUnchecked(i);
+                        auto channels = block.getSubsetChannelBlock((size_t)(i * SIMDLadderFilter::numLanes),
+                                                                    simdFilter->getNumChannels());
+                        simdFilter->process(dsp::ProcessContextReplacing<float>(channels));
+                    }
+                    break;
+
+                case LadderVariant::oversampled:
+                {
+                    auto oversampled = oversampling->processSamplesUp(block);
+                    filter.process(dsp::ProcessContextReplacing<float>(oversampled));
+                    oversampling->processSamplesDown(block);
+                    break;
+                }
+
+                case LadderVariant::process:
+                case LadderVariant::denormals:
+                case LadderVariant::denormalsFlushed:
+                default:
+                    filter.process(dsp::ProcessContextReplacing<float>(block));
+                    break;
+            }
+        }
+
+        static String getKernelName(LadderVariant variant, int numChannels, int oversamplingFactorLog2,
+                                    OversamplingType oversamplingType)
+        {
+            auto name = "ladder/" + getVariantName(variant);
+
+            if (variant == LadderVariant::oversampled)
+                return name + String(1 << oversamplingFactorLog2) + "x/"
+                         + (oversamplingType == OversamplingType::filterHalfBandPolyphaseIIR ? "iir" : "fir");
+
+            return hasChannelVariants(variant) ? name + "/channels" + String(numChannels) : name;
+        }
+
+        static bool hasChannelVariants(LadderVariant variant) noexcept
+        {
+            return variant == LadderVariant::processSample || variant == LadderVariant::process
+                    || variant == LadderVariant::simd;
+        }
+
+        bool isDenormalVariant() const noexcept
+        {
+            return variant == LadderVariant::denormals || variant == LadderVariant::denormalsFlushed;
+        }
+
+        static String getVariantName(LadderVariant variant)
+        {
+            switch (variant)
+            {
+                case LadderVariant::processSample:      return "processSample";
+                case LadderVariant::process:            return "process";
+                case LadderVariant::simd:               return "simd";
+                case LadderVariant::oversampled:        return "oversampled";
+                case LadderVariant::denormals:          return "denormals";
+                case LadderVariant::denormalsFlushed:   return "denormalsFlushed";
+                default:                                return {};
+            }
+        }
+
+        const LadderVariant variant;
+        const int numChannels;
+
+        LadderFilterAccess filter;
+        OwnedArray<SIMDLadderFilter> simdFilters;
+        ScopedPointer<dsp::Oversampling<float>> oversampling;
+
+        AudioBuffer<float> input, buffer;
+    };
+
+    // Reverb, SIMDReverb and FDNReverb, which all have processStereo()
+    template <typename ReverbType>
+    struct ReverbKernel : public Kernel
+    {
+        ReverbKernel(const String& kernelName) : Kernel("reverb/" + kernelName, blockSize)
+        {
+            reverb.setSampleRate(sampleRate);
+            fillWithNoise(input);
+        }
+
+        void run() noexcept override
+        {
+            buffer.makeCopyOf(input, true);
+            reverb.processStereo(buffer.getWritePointer(0), buffer.getWritePointer(1), blockSize);
+        }
+
+        ReverbType reverb;
+        AudioBuffer<float> input { 2, blockSize }, buffer { 2, blockSize };
+    };
+
+    // Two seconds of decaying noise as the impulse response
+    struct ConvolutionKernel : public Kernel
+    {
+        ConvolutionKernel() : Kernel("reverb/convolution2s", blockSize)
+        {
+            AudioBuffer<float> impulse(2, (int)(2.0 * sampleRate));
+            fillWithNoise(impulse);
+
+            for (auto i = 0; i < impulse.getNumSamples(); ++i)
+                for (auto ch = 0; ch < 2; ++ch)
+                    impulse.getWritePointer(ch)[i] *= std::exp(-6.9f * (float)i / impulse.getNumSamples());
+
+            // prepare() loads the impulse response before it returns
+            reverb.loadImpulseResponse(impulse, sampleRate);
+            reverb.prepare({ sampleRate, (uint32)blockSize, 2 });
+
+            fillWithNoise(input);
+        }
+
+        void run() noexcept override
+        {
+            buffer.makeCopyOf(input, true);
+            dsp::AudioBlock<float> block(buffer);
+            reverb.process(dsp::ProcessContextReplacing<float>(block));
+        }
+
+        ConvolutionReverb reverb;
+        AudioBuffer<float> input { 2, blockSize }, buffer { 2, blockSize };
+    };
+
+    // The filter, reverb and output gain over a large block, either passing the whole block
+    // through each in turn or all three over sub-blocks of subBlockSize, as BasicSynth does
+    struct OutputStageKernel : public Kernel
+    {
+        static constexpr int hostBlockSize = 4096;
+
+        OutputStageKernel(int subBlockSizeToUse)
+            : Kernel("outputStage/block" + String(hostBlockSize) + "/sub" + String(subBlockSizeToUse), hostBlockSize),
+              subBlockSize(subBlockSizeToUse)
+        {
+            const dsp::ProcessSpec spec { sampleRate, (uint32)subBlockSize, 2 };
+
+            filter.prepare(spec);
+            filter.setMode(dsp::LadderFilter<float>::Mode::LPF24);
+            filter.setCutoffFrequencyHz(2000.0f);
+
+            reverb.prepare(spec);
+
+            fillWithNoise(input);
+        }
+
+        void run() noexcept override
+        {
+            buffer.makeCopyOf(input, true);
+            dsp::AudioBlock<float> block(buffer);
+
+            for (auto start = 0; start < hostBlockSize; start += subBlockSize)
+            {
+                auto subBlock = block.getSubBlock((size_t)start, (size_t)jmin(subBlockSize, hostBlockSize - start));
+                const dsp::ProcessContextReplacing<float> context(subBlock);
+
+                filter.process(context);
+                reverb.process(context);
+                subBlock.multiply(0.5f);
+            }
+        }
+
+        const int subBlockSize;
+
+        dsp::LadderFilter<float> filter;
+        SIMDReverb reverb;
+        AudioBuffer<float> input { 2, hostBlockSize }, buffer { 2, hostBlockSize };
+    };
+
+    // Every kernel, in the order they are reported
+    static void createKernels(OwnedArray<Kernel>& kernels)
+    {
+        for (auto sizeLog2 : { 8, SineTable::defaultSizeLog2, 16 })
+            kernels.add(new VoiceKernel(sizeLog2));
+
+        kernels.add(new StdSinVoiceKernel());
+
+        kernels.add(new SynthKernel(16, true, 0, 0));
+        kernels.add(new SynthKernel(16, false, 0, 0));
+        kernels.add(new SynthKernel(16, true, 0, 16));
+        kernels.add(new SynthKernel(64, true, 0, 0));
+
+        if (SystemStats::getNumCpus() > 1)
+            kernels.add(new SynthKernel(64, true, jmin(3, SystemStats::getNumCpus() - 1), 0));
+
+        for (auto numEvents : { 1, 16, 128 })
+            kernels.add(new MidiIterationKernel(numEvents));
+
+        for (auto variant : { LadderVariant::processSample, LadderVariant::process, LadderVariant::simd })
+            for (auto numChannels : { 1, 2, 8 })
+                kernels.add(new LadderKernel(variant, numChannels));
+
+        for (auto factorLog2 : { 1, 2, 3 })
+            for (auto type : { OversamplingType::filterHalfBandPolyphaseIIR, OversamplingType::filterHalfBandFIREquiripple })
+                kernels.add(new LadderKernel(LadderVariant::oversampled, 2, factorLog2, type));
+
+        for (auto variant : { LadderVariant::denormals, LadderVariant::denormalsFlushed })
+            kernels.add(new LadderKernel(variant));
+
+        kernels.add(new ReverbKernel<Reverb>("juce"));
+        kernels.add(new ReverbKernel<SIMDReverb>("simd"));
+
+        auto* fdn8 = new ReverbKernel<FDNReverb>("fdn8");
+        fdn8->reverb.setQuality(FDNReverb::Quality::low);
+        kernels.add(fdn8);
+
+        kernels.add(new ReverbKernel<FDNReverb>("fdn16"));
+        kernels.add(new ConvolutionKernel());
+
+        kernels.add(new OutputStageKernel(OutputStageKernel::hostBlockSize));
+        kernels.add(new OutputStageKernel(256));
+    }
+
+private:
+    // Turns flush-to-zero on for its lifetime, or leaves it off
+    struct ScopedFlushDenormals
+    {
+        ScopedFlushDenormals(bool shouldFlush)
+        {
+            if (shouldFlush)
+                noDenormals = new ScopedNoDenormals();
+        }
+
+        ScopedPointer<ScopedNoDenormals> noDenormals;
+    };
+
+    static void fillWithNoise(AudioBuffer<float>& buffer)
+    {
+        Random random(1);
+
+        for (auto ch = 0; ch < buffer.getNumChannels(); ++ch)
+            for (auto i = 0; i < buffer.getNumSamples(); ++i)
+                buffer.setSample(ch, i, random.nextFloat() - 0.5f);
+    }
+
+    // Writing to every cache line of the buffer pushes everything else out of the caches
+    void evictCaches() noexcept
+    {
+        for (size_t i = 0; i < evictionBufferSize; i += 64)
+            ++evictionBuffer[i];
+    }
+
+    HeapBlock<uint8> evictionBuffer;
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+// Carries MIDI from the on-screen keyboard and MIDI inputs to the audio thread without locks.
+//
+// MidiMessageCollector and MidiKeyboardState::processNextMidiBuffer() both take a CriticalSection
+// that the GUI and MIDI input threads also hold while they add events, so a burst of controller
+// traffic can keep the audio thread waiting. This queue instead stores fixed-size event records
+// in a preallocated ring (Dmitry Vyukov's bounded queue). Each slot carries a sequence number
+// that says whether it is free or full for the current lap of the ring:
+//
+//  - Producers, on any number of threads, claim a slot with a compare-and-swap on the write
+//    position, copy the event in and then publish it by bumping the slot's sequence number.
+//    Nothing allocates and no thread ever waits for another to leave a critical section.
+//  - The audio thread is the only consumer. It reads published slots in order, up to the write
+//    position it saw at the start of the block, and stops early at the first one that isn't
+//    published yet. So it is wait-free: it never retries, spins or waits for a producer.
+//
+// Only short messages (up to 3 bytes) are queued, which is everything the synth responds to.
+// Sysex is dropped, as are events that arrive when the ring is full (see getNumDroppedEvents()).
+//
+// Events are timestamped with Time::getMillisecondCounterHiRes() as they arrive, the same clock
+// MidiInput uses. readNextBlock() plays them back with one block of latency: the block being
+// rendered stands for the time between the previous callback and now, and each event is placed
+// at the matching sample offset. This keeps the spacing of fast passages instead of bunching
+// every event at the start of the block.
+struct MidiEventQueue : public MidiKeyboardStateListener,
+                        public MidiInputCallback
+{
+    static constexpr int capacity = 1024;
+
+    MidiEventQueue()
+    {
+        for (auto i = 0; i < capacity; ++i)
+            slots[i].sequence.store((uint32)i, std::memory_order_relaxed);
+    }
+
+    // Sets the sample rate used to convert timestamps and throws away anything still queued.
+    // Call this while the audio thread is stopped, for example from prepareToPlay().
+    void reset(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        lastBlockTime = getCurrentTime();
+
+        while (auto* slot = getNextPublishedSlot())
+            releaseSlot(*slot);
+    }
+
+    // Can be called from any thread. Returns false if the event was dropped.
+    bool push(const MidiMessage& message, double timeStampSeconds) noexcept
+    {
+        const auto numBytes = message.getRawDataSize();
+
+        if (numBytes > 3 || message.isSysEx())
+            return false;
+
+        auto position = writePosition.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            auto& slot = slots[position & (capacity - 1)];
+            const auto sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto difference = (int32)(sequence - position);
+
+            if (difference == 0)
+            {
+                if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    slot.timeStamp = timeStampSeconds;
+                    slot.numBytes = (uint8)numBytes;
+                    memcpy(slot.data, message.getRawData(), (size_t)numBytes);
+
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                // The slot still holds an event from the previous lap, so the ring is full
+                numDroppedEvents.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                position = writePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Audio thread only. Moves every published event into the buffer, positioned within the next
+    // numSamples samples. The buffer isn't cleared first, so events can be merged with others.
+    void readNextBlock(MidiBuffer& destBuffer, int numSamples) noexcept
+    {
+        jassert(numSamples > 0);
+
+        const auto now = getCurrentTime();
+        const auto blockStart = lastBlockTime;
+        lastBlockTime = now;
+
+        // Only take what had been claimed when the block started, otherwise producers that keep
+        // refilling the ring could keep the audio thread here forever
+        const auto end = writePosition.load(std::memory_order_relaxed);
+
+        while (readPosition != end)
+        {
+            auto* slot = getNextPublishedSlot();
+
+            if (slot == nullptr)
+                break;
+
+            destBuffer.addEvent(slot->data, slot->numBytes,
+                                timeStampToSampleOffset(slot->timeStamp, blockStart, numSamples));
+            releaseSlot(*slot);
+        }
+    }
+
+    int getNumDroppedEvents() const noexcept
+    {
+        return numDroppedEvents.load(std::memory_order_relaxed);
+    }
+
+    void handleNoteOn(MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        push(MidiMessage::noteOn(midiChannel, midiNoteNumber, velocity), getCurrentTime());
+    }
+
+    void handleNoteOff(MidiKeyboardState*, int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        push(MidiMessage::noteOff(midiChannel, midiNoteNumber, velocity), getCurrentTime());
+    }
+
+    void handleIncomingMidiMessage(MidiInput*, const MidiMessage& message) override
+    {
+        push(message, message.getTimeStamp());
+    }
+
+private:
+    static double getCurrentTime() noexcept
+    {
+        return Time::getMillisecondCounterHiRes() * 0.001;
+    }
+
+    struct Slot
+    {
+        std::atomic<uint32> sequence;
+        double timeStamp;
+        uint8 data[3];
+        uint8 numBytes;
+    };
+
+    Slot* getNextPublishedSlot() noexcept
+    {
+        auto& slot = slots[readPosition & (capacity - 1)];
+        return slot.sequence.load(std::memory_order_acquire) == readPosition + 1 ? &slot : nullptr;
+    }
+
+    // Hands the slot back to the producers for the next lap of the ring
+    void releaseSlot(Slot& slot) noexcept
+    {
+        slot.sequence.store(readPosition + (uint32)capacity, std::memory_order_release);
+        ++readPosition;
+    }
+
+    // Events that arrived before the previous callback (late ones, or ones queued while the audio
+    // was stopped) go at the start of the block, and ones stamped after now at the end
+    int timeStampToSampleOffset(double timeStamp, double blockStart, int numSamples) const noexcept
+    {
+        return jlimit(0, numSamples - 1, roundToInt((timeStamp - blockStart) * sampleRate));
+    }
+
+    Slot slots[capacity];
+
+    // Padded apart so producers and the consumer don't keep stealing each other's cache line
+    std::atomic<uint32> writePosition { 0 };
+    char padding[64];
+    uint32 readPosition = 0;
+
+    std::atomic<int> numDroppedEvents { 0 };
+    double sampleRate = 44100.0;
+    double lastBlockTime = 0.0;
+};
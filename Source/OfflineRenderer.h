@@ -0,0 +1,217 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "PluginProcessor.h"
+
+// Plays a MIDI file through a BasicSynth and writes the result to an audio file, as fast as the
+// synth can render it. This is what the command line renderer runs, see RenderMain.cpp.
+//
+// The synth is driven the way a host drives the plugin: prepareToPlay(), then processBlock() with
+// a fixed block size and the MIDI events of each block at their sample positions. It is put in
+// non-realtime mode, and nothing waits on the clock, so a render is limited only by the CPU. In
+// that mode the convolution reverb renders its tail in full instead of leaving out blocks its
+// thread hasn't finished, so the same file renders the same every time.
+struct OfflineRenderer
+{
+    struct Settings
+    {
+        double sampleRate = 48000.0;
+        int blockSize = 512;
+        int numVoices = 16;
+
+        // 16 or 24 for FLAC, 16, 24 or 32 (float) for WAV
+        int bitsPerSample = 24;
+
+        // How long to keep rendering after the last MIDI event. Negative means the synth's own
+        // tail, see BasicSynth::getTailLengthSeconds().
+        double tailSeconds = -1.0;
+
+        // A state saved by the plugin (the XML of its parameters), and parameter values to set on
+        // top of it, as parameter ID to value in the parameter's own range
+        File stateFile;
+        StringPairArray parameterValues;
+    };
+
+    struct Stats
+    {
+        double audioSeconds = 0.0;
+        double renderSeconds = 0.0;
+
+        // How many seconds of audio were rendered per second of wall clock time
+        double getRealtimeMultiple() const noexcept
+        {
+            return renderSeconds > 0.0 ? audioSeconds / renderSeconds : 0.0;
+        }
+    };
+
+    // The output format is chosen from the output file's extension
+    static Result render(const File& midiFile, const File& outputFile, const Settings& settings, Stats& stats)
+    {
+        ScopedPointer<AudioFormatWriter> writer(createWriter(outputFile, settings));
+
+        if (writer == nullptr)
+            return Result::fail("Couldn't create " + outputFile.getFullPathName());
+
+        const auto result = render(midiFile, settings, stats, [&](const AudioBuffer<float>& block)
+        {
+            return writer->writeFromAudioSampleBuffer(block, 0, block.getNumSamples());
+        });
+
+        if (result.failed())
+            return result;
+
+        // Deleting the writer finishes off the file
+        writer = nullptr;
+        return Result::ok();
+    }
+
+    // Renders the MIDI file and passes each block of audio to writeBlock, which returns false to
+    // stop the render with an error. The time in the stats includes the time spent in writeBlock.
+    template <typename WriteBlockFunction>
+    static Result render(const File& midiFile, const Settings& settings, Stats& stats,
+                         WriteBlockFunction&& writeBlock)
+    {
+        MidiMessageSequence sequence;
+        auto result = readMidiFile(midiFile, sequence);
+
+        if (result.failed())
+            return result;
+
+        BasicSynth synth;
+        result = setUpSynth(synth, settings);
+
+        if (result.failed())
+            return result;
+
+        const auto tailSeconds = settings.tailSeconds >= 0.0 ? settings.tailSeconds
+                                                             : synth.getTailLengthSeconds();
+        const auto totalSamples = (int64)std::ceil((sequence.getEndTime() + tailSeconds) * settings.sampleRate);
+
+        AudioBuffer<float> buffer(2, settings.blockSize);
+        MidiBuffer midi;
+        auto nextEvent = 0;
+
+        const auto startTime = Time::getMillisecondCounterHiRes();
+
+        for (int64 position = 0; position < totalSamples; position += settings.blockSize)
+        {
+            const auto numSamples = (int)jmin((int64)settings.blockSize, totalSamples - position);
+
+            midi.clear();
+
+            for (; nextEvent < sequence.getNumEvents(); ++nextEvent)
+            {
+                const auto& message = sequence.getEventPointer(nextEvent)->message;
+                const auto samplePosition = (int64)(message.getTimeStamp() * settings.sampleRate);
+
+                if (samplePosition >= position + numSamples)
+                    break;
+
+                midi.addEvent(message, (int)jmax((int64)0, samplePosition - position));
+            }
+
+            // The last block is usually short, so it gets a buffer that refers to part of the
+            // full one
+            AudioBuffer<float> block(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), numSamples);
+            block.clear();
+
+            synth.processBlock(block, midi);
+
+            if (! writeBlock(static_cast<const AudioBuffer<float>&>(block)))
+                return Result::fail("Couldn't write the output of " + midiFile.getFullPathName());
+        }
+
+        stats.audioSeconds = (double)totalSamples / settings.sampleRate;
+        stats.renderSeconds = (Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+
+        return Result::ok();
+    }
+
+    // Reads every track of a MIDI file into one sequence, with its times in seconds
+    static Result readMidiFile(const File& file, MidiMessageSequence& sequence)
+    {
+        FileInputStream stream(file);
+        MidiFile midiFile;
+
+        if (stream.failedToOpen() || ! midiFile.readFrom(stream))
+            return Result::fail("Couldn't read MIDI file " + file.getFullPathName());
+
+        midiFile.convertTimestampTicksToSeconds();
+
+        for (auto i = 0; i < midiFile.getNumTracks(); ++i)
+            sequence.addSequence(*midiFile.getTrack(i), 0.0);
+
+        // Tempo, time signature and other meta events are of no use to the synth
+        for (auto i = sequence.getNumEvents(); --i >= 0;)
+            if (sequence.getEventPointer(i)->message.isMetaEvent())
+                sequence.deleteEvent(i, false);
+
+        sequence.sort();
+        return Result::ok();
+    }
+
+    // Applies the settings and prepares the synth to play
+    static Result setUpSynth(BasicSynth& synth, const Settings& settings)
+    {
+        if (settings.stateFile != File())
+        {
+            ScopedPointer<XmlElement> xml(XmlDocument::parse(settings.stateFile));
+
+            if (xml == nullptr || ! xml->hasTagName(synth.parameters.state.getType().toString()))
+                return Result::fail("Couldn't read a BasicSynth state from " + settings.stateFile.getFullPathName());
+
+            MemoryBlock state;
+            AudioProcessor::copyXmlToBinary(*xml, state);
+            synth.setStateInformation(state.getData(), (int)state.getSize());
+        }
+
+        const auto& keys = settings.parameterValues.getAllKeys();
+
+        for (auto i = 0; i < keys.size(); ++i)
+        {
+            auto* parameter = synth.parameters.getParameter(keys[i]);
+
+            if (parameter == nullptr)
+                return Result::fail("Unknown parameter " + keys[i]);
+
+            const auto range = synth.parameters.getParameterRange(keys[i]);
+            const auto value = settings.parameterValues.getAllValues()[i].getFloatValue();
+
+            parameter->setValueNotifyingHost(range.convertTo0to1(range.snapToLegalValue(value)));
+        }
+
+        synth.synthAudioSource.setPolyphony(settings.numVoices);
+
+        synth.setNonRealtime(true);
+        synth.setPlayConfigDetails(0, 2, settings.sampleRate, settings.blockSize);
+        synth.prepareToPlay(settings.sampleRate, settings.blockSize);
+
+        return Result::ok();
+    }
+
+    static AudioFormatWriter* createWriter(const File& file, const Settings& settings)
+    {
+        AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        auto* format = formatManager.findFormatForFileExtension(file.getFileExtension());
+
+        if (format == nullptr)
+            return nullptr;
+
+        file.deleteFile();
+        ScopedPointer<FileOutputStream> stream(file.createOutputStream());
+
+        if (stream == nullptr)
+            return nullptr;
+
+        auto* writer = format->createWriterFor(stream, settings.sampleRate, 2,
+                                               settings.bitsPerSample, {}, 0);
+
+        // The writer owns the stream once it has been created
+        if (writer != nullptr)
+            stream.release();
+
+        return writer;
+    }
+};
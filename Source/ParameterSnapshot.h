@@ -0,0 +1,139 @@
+#pragma once
+
+// The values of all of the plugin's parameters as seen by one audio block, together with a mask
+// of the ones that changed since the previous block. DSP code only needs to recalculate
+// coefficients for the parameters whose bit is set.
+struct ParameterSnapshot
+{
+    enum Index
+    {
+        filterMode,
+        filterCutoff,
+        filterResonance,
+        filterDrive,
+        reverbRoomSize,
+        reverbDamping,
+        reverbWidth,
+        reverbFreeze,
+        reverbDry,
+        reverbWet,
+        reverbType,
+        reverbQuality,
+        output,
+        numParameters
+    };
+
+    static constexpr uint32 getBit(Index index) noexcept
+    {
+        return 1u << index;
+    }
+
+    static constexpr uint32 allParameters = (1u << numParameters) - 1u;
+
+    // Width is left out because the reverb doesn't use it yet
+    static constexpr uint32 reverbParameters = (1u << reverbRoomSize) | (1u << reverbDamping)
+                                             | (1u << reverbFreeze) | (1u << reverbDry)
+                                             | (1u << reverbWet);
+
+    float operator[](Index index) const noexcept
+    {
+        return values[index];
+    }
+
+    bool hasChanged(Index index) const noexcept
+    {
+        return (changed & getBit(index)) != 0;
+    }
+
+    // True if any of the parameters in the mask changed
+    bool hasAnyChanged(uint32 mask) const noexcept
+    {
+        return (changed & mask) != 0;
+    }
+
+    int getNumChanged() const noexcept
+    {
+        auto count = 0;
+
+        for (auto bits = changed; bits != 0; bits &= bits - 1)
+            ++count;
+
+        return count;
+    }
+
+    float values[numParameters] = {};
+    uint32 changed = 0;
+};
+
+// Keeps a ParameterSnapshot up to date from an AudioProcessorValueTreeState.
+//
+// The raw float pointers the value tree state hands out are plain, non-atomic floats that the
+// host or the editor may write while the audio thread is reading them. Instead, this listens to
+// every parameter and copies each new value into its own atomic, setting the parameter's bit in
+// an atomic dirty mask. Once per block the audio thread swaps the mask for zero and re-reads only
+// the values whose bits were set. Listeners may be called from any thread, including the audio
+// thread during host automation; neither side allocates or locks.
+struct ParameterTracker
+{
+    ~ParameterTracker()
+    {
+        for (auto& listener : listeners)
+            if (listener.state != nullptr)
+                listener.state->removeParameterListener(listener.parameterID, &listener);
+    }
+
+    // Starts tracking a parameter. Call this from the message thread once the parameter exists.
+    void attach(AudioProcessorValueTreeState& state, ParameterSnapshot::Index index, StringRef parameterID)
+    {
+        auto& listener = listeners[index];
+
+        listener.owner = this;
+        listener.index = index;
+        listener.state = &state;
+        listener.parameterID = parameterID;
+
+        state.addParameterListener(parameterID, &listener);
+        listener.parameterChanged(parameterID, *state.getRawParameterValue(parameterID));
+    }
+
+    // Flags every parameter as changed, so the next snapshot makes the DSP pick all of them up
+    void markAllChanged() noexcept
+    {
+        pendingChanges.fetch_or(ParameterSnapshot::allParameters, std::memory_order_release);
+    }
+
+    // Called by the audio thread once per block. The returned snapshot stays valid until the
+    // next call.
+    const ParameterSnapshot& getNextSnapshot() noexcept
+    {
+        const auto changed = pendingChanges.exchange(0, std::memory_order_acquire);
+
+        for (auto i = 0; i < ParameterSnapshot::numParameters; ++i)
+            if ((changed & (1u << i)) != 0)
+                snapshot.values[i] = values[i].load(std::memory_order_relaxed);
+
+        snapshot.changed = changed;
+        return snapshot;
+    }
+
+private:
+    struct Listener : public AudioProcessorValueTreeState::Listener
+    {
+        void parameterChanged(const String&, float newValue) override
+        {
+            owner->values[index].store(newValue, std::memory_order_relaxed);
+            owner->pendingChanges.fetch_or(1u << index, std::memory_order_release);
+        }
+
+        ParameterTracker* owner = nullptr;
+        int index = 0;
+        AudioProcessorValueTreeState* state = nullptr;
+        String parameterID;
+    };
+
+    Listener listeners[ParameterSnapshot::numParameters];
+    std::atomic<float> values[ParameterSnapshot::numParameters] {};
+    std::atomic<uint32> pendingChanges { 0 };
+
+    ParameterSnapshot snapshot;
+};
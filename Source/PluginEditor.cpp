@@ -145,6 +145,57 @@ BasicSynthEditor::BasicSynthEditor(BasicSynth &p)
     reverbSection.setText("Reverb");
     addAndMakeVisible(reverbSection);
 
+    reverbType.setName("Type");
+    reverbType.setTooltip("Type");
+    reverbType.getRootMenu()->addItem(1, "Algorithmic");
+    reverbType.getRootMenu()->addItem(2, "Convolution");
+    reverbType.getRootMenu()->addItem(3, "FDN");
+    reverbType.setWantsKeyboardFocus(false);
+    addAndMakeVisible(reverbType);
+
+    comboBoxAttachments.add(
+        new ComboBoxAttachment(processor.parameters, BasicSynth::REVERB_TYPE, reverbType)
+    );
+
+    // The number of delay lines in the FDN reverb
+    reverbQuality.setName("Quality");
+    reverbQuality.setTooltip("FDN quality: 8 or 16 delay lines");
+    reverbQuality.getRootMenu()->addItem(1, "Low");
+    reverbQuality.getRootMenu()->addItem(2, "High");
+    reverbQuality.setWantsKeyboardFocus(false);
+    addAndMakeVisible(reverbQuality);
+
+    comboBoxAttachments.add(
+        new ComboBoxAttachment(processor.parameters, BasicSynth::REVERB_QUALITY, reverbQuality)
+    );
+
+    // The impulse response is loaded in the background, so the file chooser is all that happens
+    // on the message thread
+    const File impulseResponseFile = processor.getImpulseResponseFile();
+
+    loadImpulseResponse.setButtonText(impulseResponseFile == File() ? "Load IR..."
+                                                                    : impulseResponseFile.getFileNameWithoutExtension());
+    loadImpulseResponse.setTooltip("Impulse response for the convolution reverb");
+    loadImpulseResponse.setWantsKeyboardFocus(false);
+    addAndMakeVisible(loadImpulseResponse);
+
+    loadImpulseResponse.onClick = [this]
+    {
+        impulseResponseChooser = new FileChooser("Load Impulse Response", File(), "*.wav;*.aif;*.aiff;*.flac");
+
+        impulseResponseChooser->launchAsync(FileBrowserComponent::openMode | FileBrowserComponent::canSelectFiles,
+                                            [this](const FileChooser& chooser)
+        {
+            const File file = chooser.getResult();
+
+            if (file.existsAsFile())
+            {
+                processor.loadImpulseResponse(file);
+                loadImpulseResponse.setButtonText(file.getFileNameWithoutExtension());
+            }
+        });
+    };
+
     // Output Controls
     // =============================================================================================
 
@@ -173,10 +224,36 @@ BasicSynthEditor::BasicSynthEditor(BasicSynth &p)
     keyboardComponent.setColour(MidiKeyboardComponent::mouseOverKeyOverlayColourId, colour.withAlpha(0.5f));
     addAndMakeVisible(keyboardComponent);
 
+    // CPU Meter
     // =============================================================================================
 
-    // Start a timer so our piano grabs keyboard focus every second
-    startTimerHz(1);
+    cpuMeter.setTooltip("CPU load of each stage. Click to save a report of the slowest blocks.");
+    addAndMakeVisible(cpuMeter);
+
+    // The report is the evidence to ask for when someone hears crackles, see XrunDetector.h
+    cpuMeter.onClick = [this]
+    {
+        xrunReportChooser = new FileChooser("Save Block Timing Report", File(), "*.json");
+
+        xrunReportChooser->launchAsync(FileBrowserComponent::saveMode | FileBrowserComponent::canSelectFiles
+                                         | FileBrowserComponent::warnAboutOverwriting,
+                                       [this](const FileChooser& chooser)
+        {
+            if (chooser.getResult() == File())
+                return;
+
+            const File file = chooser.getResult().withFileExtension("json");
+
+            if (! processor.saveXrunReport(file))
+                AlertWindow::showMessageBoxAsync(AlertWindow::WarningIcon, "Save Block Timing Report",
+                                                 "Couldn't write " + file.getFullPathName());
+        });
+    };
+
+    // =============================================================================================
+
+    // Start a timer to update the CPU meter and have our piano grab keyboard focus every second
+    startTimerHz(timerHz);
 
     // We set our size at the end of our constructor so our resized() method is called to set up
     // our layout
@@ -185,9 +262,14 @@ BasicSynthEditor::BasicSynthEditor(BasicSynth &p)
 
 void BasicSynthEditor::timerCallback()
 {
+    // The meter shows the load since the last tick, read from the audio thread's counters
+    cpuMeter.update(processor.stageTimings.getSnapshot(), processor.xrunDetector.getNumLateBlocks(),
+                    processor.qualityGovernor.getLevel());
+
     // Have the piano component continuously grab keyboard focus so that our keypresses always
     // trigger notes.
-    keyboardComponent.grabKeyboardFocus();
+    if (++timerTicks % timerHz == 0)
+        keyboardComponent.grabKeyboardFocus();
 }
 
 void BasicSynthEditor::paint (Graphics& g)
@@ -245,7 +327,10 @@ void BasicSynthEditor::resized()
             .reduced(0, pad / 2)
     );
 
-    bounds.removeFromBottom(30);
+    // The strip above the keyboard holds the CPU meter under the filter, and the reverb type and
+    // impulse response controls under the reverb
+    Rectangle<int> strip = bounds.removeFromBottom(30);
+    const Rectangle<int> meterStrip = strip;
 
     // Output Controls
     // =============================================================================================
@@ -304,6 +389,25 @@ void BasicSynthEditor::resized()
 
     wetLevel.setBounds(section);
 
+    strip = strip
+        .withLeft(reverbSection.getX())
+        .withRight(reverbSection.getRight())
+        .reduced(pad, pad / 2);
+
+    reverbType.setBounds(
+        strip
+            .removeFromLeft(strip.getWidth() / 3)
+            .reduced(pad / 2, 0)
+    );
+
+    reverbQuality.setBounds(
+        strip
+            .removeFromLeft(strip.getWidth() / 2)
+            .reduced(pad / 2, 0)
+    );
+
+    loadImpulseResponse.setBounds(strip.reduced(pad / 2, 0));
+
     // Filter Controls
     // =============================================================================================
 
@@ -339,4 +443,14 @@ void BasicSynthEditor::resized()
     );
 
     drive.setBounds(section);
+
+    // CPU Meter
+    // =============================================================================================
+
+    cpuMeter.setBounds(
+        meterStrip
+            .withLeft(filterSection.getX())
+            .withRight(filterSection.getRight())
+            .reduced(pad, pad / 2)
+    );
 }
@@ -2,6 +2,7 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "PluginProcessor.h"
+#include "CpuMeter.h"
 
 // These names are pretty long, so define some typedefs to shorten up our typing
 typedef AudioProcessorValueTreeState::SliderAttachment   SliderAttachment;
@@ -34,11 +35,22 @@ struct BasicSynthEditor : public AudioProcessorEditor,
     Slider wetLevel;
     GroupComponent reverbSection;
 
+    ComboBox reverbType;
+    ComboBox reverbQuality;
+    TextButton loadImpulseResponse;
+    ScopedPointer<FileChooser> impulseResponseChooser;
+
     Slider outputGain;
     GroupComponent outputSection;
 
     MidiKeyboardComponent keyboardComponent;
 
+    CpuMeter cpuMeter;
+    ScopedPointer<FileChooser> xrunReportChooser;
+
+    static constexpr int timerHz = 10;
+    int timerTicks = 0;
+
     OwnedArray<SliderAttachment>   sliderAttachments;
     OwnedArray<ComboBoxAttachment> comboBoxAttachments;
     OwnedArray<ButtonAttachment>   buttonAttachments;
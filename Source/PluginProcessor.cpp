@@ -12,8 +12,12 @@ const StringRef BasicSynth::REVERB_WIDTH     = "reverb_width";
 const StringRef BasicSynth::REVERB_FREEZE    = "reverb_freeze";
 const StringRef BasicSynth::REVERB_DRY       = "reverb_dry";
 const StringRef BasicSynth::REVERB_WET       = "reverb_wet";
+const StringRef BasicSynth::REVERB_TYPE      = "reverb_type";
+const StringRef BasicSynth::REVERB_QUALITY   = "reverb_quality";
 
 const StringRef BasicSynth::OUTPUT           = "output";
+
+const Identifier BasicSynth::IMPULSE_RESPONSE_FILE = "impulse_response_file";
 
 BasicSynth::BasicSynth() :
     AudioProcessor(BusesProperties().withOutput("Output", AudioChannelSet::stereo(), true)),
@@ -79,7 +83,7 @@ BasicSynth::BasicSynth() :
         true,  // isAutomatableParameter
         true   // isDiscrete
     );
-    filterMode = parameters.getRawParameterValue(FILTER_MODE);
+    parameterTracker.attach(parameters, ParameterSnapshot::filterMode, FILTER_MODE);
 
     parameters.createAndAddParameter(
         FILTER_CUTOFF,
@@ -90,7 +94,7 @@ BasicSynth::BasicSynth() :
         nullptr,
         nullptr
     );
-    filterCutoff = parameters.getRawParameterValue(FILTER_CUTOFF);
+    parameterTracker.attach(parameters, ParameterSnapshot::filterCutoff, FILTER_CUTOFF);
 
     parameters.createAndAddParameter(
         FILTER_RESONANCE,
@@ -101,7 +105,7 @@ BasicSynth::BasicSynth() :
         nullptr,
         nullptr
     );
-    filterResonance = parameters.getRawParameterValue(FILTER_RESONANCE);
+    parameterTracker.attach(parameters, ParameterSnapshot::filterResonance, FILTER_RESONANCE);
 
     parameters.createAndAddParameter(
         FILTER_DRIVE,
@@ -112,7 +116,7 @@ BasicSynth::BasicSynth() :
         nullptr,
         nullptr
     );
-    filterDrive = parameters.getRawParameterValue(FILTER_DRIVE);
+    parameterTracker.attach(parameters, ParameterSnapshot::filterDrive, FILTER_DRIVE);
 
     // Reverb Controls
     // =============================================================================================
@@ -126,7 +130,7 @@ BasicSynth::BasicSynth() :
         nullptr,
         nullptr
     );
-    reverbRoomSize = parameters.getRawParameterValue(REVERB_ROOM_SIZE);
+    parameterTracker.attach(parameters, ParameterSnapshot::reverbRoomSize, REVERB_ROOM_SIZE);
 
     parameters.createAndAddParameter(
         REVERB_DAMPING,
@@ -137,7 +141,7 @@ BasicSynth::BasicSynth() :
         nullptr,
         nullptr
     );
-    reverbDamping = parameters.getRawParameterValue(REVERB_DAMPING);
+    parameterTracker.attach(parameters, ParameterSnapshot::reverbDamping, REVERB_DAMPING);
 
     parameters.createAndAddParameter(
         REVERB_WIDTH,
@@ -148,7 +152,7 @@ BasicSynth::BasicSynth() :
         nullptr,
         nullptr
     );
-    reverbWidth = parameters.getRawParameterValue(REVERB_WIDTH);
+    parameterTracker.attach(parameters, ParameterSnapshot::reverbWidth, REVERB_WIDTH);
 
     parameters.createAndAddParameter(
         REVERB_FREEZE,
@@ -159,7 +163,7 @@ BasicSynth::BasicSynth() :
         nullptr,
         nullptr
     );
-    reverbFreeze = parameters.getRawParameterValue(REVERB_FREEZE);
+    parameterTracker.attach(parameters, ParameterSnapshot::reverbFreeze, REVERB_FREEZE);
 
     parameters.createAndAddParameter(
         REVERB_DRY,
@@ -170,7 +174,7 @@ BasicSynth::BasicSynth() :
         nullptr,
         nullptr
     );
-    reverbDry = parameters.getRawParameterValue(REVERB_DRY);
+    parameterTracker.attach(parameters, ParameterSnapshot::reverbDry, REVERB_DRY);
 
     parameters.createAndAddParameter(
         REVERB_WET,
@@ -181,7 +185,59 @@ BasicSynth::BasicSynth() :
         nullptr,
         nullptr
     );
-    reverbWet = parameters.getRawParameterValue(REVERB_WET);
+    parameterTracker.attach(parameters, ParameterSnapshot::reverbWet, REVERB_WET);
+
+    parameters.createAndAddParameter(
+        REVERB_TYPE,
+        "Reverb Type",
+        "",
+        NormalisableRange<float>(0.0f, 2.0f, 1.0f),
+        0.0f,
+        [](float value)
+        {
+            switch ((int)value)
+            {
+                case 0: return "Algorithmic";
+                case 1: return "Convolution";
+                case 2: return "FDN";
+                default: return "";
+            }
+        },
+        [](const String &text)
+        {
+            if (text == "Convolution")
+                return 1.0f;
+            else if (text == "FDN")
+                return 2.0f;
+            else
+                return 0.0f;
+        },
+        false, // isMetaParameter
+        true,  // isAutomatableParameter
+        true   // isDiscrete
+    );
+    parameterTracker.attach(parameters, ParameterSnapshot::reverbType, REVERB_TYPE);
+
+    // The number of delay lines in the FDN reverb
+    parameters.createAndAddParameter(
+        REVERB_QUALITY,
+        "Reverb Quality",
+        "",
+        NormalisableRange<float>(0.0f, 1.0f, 1.0f),
+        1.0f,
+        [](float value)
+        {
+            return value < 0.5f ? "Low" : "High";
+        },
+        [](const String &text)
+        {
+            return text == "Low" ? 0.0f : 1.0f;
+        },
+        false, // isMetaParameter
+        true,  // isAutomatableParameter
+        true   // isDiscrete
+    );
+    parameterTracker.attach(parameters, ParameterSnapshot::reverbQuality, REVERB_QUALITY);
 
     // Output Control
     // =============================================================================================
@@ -195,9 +251,14 @@ BasicSynth::BasicSynth() :
         nullptr,
         nullptr
     );
-    output = parameters.getRawParameterValue(OUTPUT);
+    parameterTracker.attach(parameters, ParameterSnapshot::output, OUTPUT);
 
     parameters.state = ValueTree("BasicSynth");
+
+    synthAudioSource.synth.setStageTimings(&stageTimings);
+
+    if (wrapperType != wrapperType_Undefined)
+        qualityGovernorLog = new QualityGovernorLog(qualityGovernor);
 }
 
 BasicSynth::~BasicSynth()
@@ -226,7 +287,7 @@ bool BasicSynth::isMidiEffect() const
 
 double BasicSynth::getTailLengthSeconds() const
 {
-    return 0.0;
+    return tailLengthSeconds.load(std::memory_order_relaxed);
 }
 
 int BasicSynth::getNumPrograms()
@@ -259,47 +320,117 @@ void BasicSynth::prepareToPlay(double sampleRate, int samplesPerBlock)
     // this happens when you move the playhead. Here in our standalone plugin it only happens
     // when the plugin starts up or if the sample rate or block size are changed.
 
+    // The effects are given at most effectsBlockSize samples at a time, see processBlock()
+    effectsBlockSize = fusedOutputStage ? jmin(samplesPerBlock, fusedBlockSize) : samplesPerBlock;
+
     // ProcessSpec is a struct that holds information about our current audio processing.
     dsp::ProcessSpec spec;
     spec.sampleRate       = sampleRate;
-    spec.maximumBlockSize = (uint32)samplesPerBlock;
+    spec.maximumBlockSize = (uint32)effectsBlockSize;
     spec.numChannels      = 2;
 
-    ladderFilter.reset();
+    // Take a snapshot with every parameter marked as changed, so everything gets set up
+    parameterTracker.markAllChanged();
+    const auto& params = parameterTracker.getNextSnapshot();
+
+    // The filter runs at the oversampled rate, if oversampling is on
+    dsp::ProcessSpec filterSpec = spec;
 
-    if (*filterMode < 1.0f)
-        ladderFilter.setMode(dsp::LadderFilter<float>::Mode::LPF12);
-    else if (*filterMode < 2.0f)
-        ladderFilter.setMode(juce::dsp::LadderFilter<float>::Mode::HPF12);
-    else if (*filterMode < 3.0f)
-        ladderFilter.setMode(juce::dsp::LadderFilter<float>::Mode::LPF24);
+    if (filterOversamplingFactorLog2 > 0)
+    {
+        filterOversampling = new dsp::Oversampling<float>(spec.numChannels, (size_t)filterOversamplingFactorLog2,
+                                                          filterOversamplingType);
+        filterOversampling->initProcessing((size_t)effectsBlockSize);
+
+        filterSpec.sampleRate       *= filterOversampling->getOversamplingFactor();
+        filterSpec.maximumBlockSize *= (uint32)filterOversampling->getOversamplingFactor();
+
+        setLatencySamples(roundToInt(filterOversampling->getLatencyInSamples()));
+    }
     else
-        ladderFilter.setMode(juce::dsp::LadderFilter<float>::Mode::HPF24);
+    {
+        filterOversampling = nullptr;
+        setLatencySamples(0);
+    }
 
-    lastFilterMode = *filterMode;
+    oversamplingLatency.prepare((int)spec.numChannels, getLatencySamples());
 
-    ladderFilter.setCutoffFrequencyHz(*filterCutoff);
-    ladderFilter.setResonance(*filterResonance);
-    ladderFilter.setDrive(*filterDrive);
-    ladderFilter.prepare(spec);
+    // Starts at full quality, and lets the governor find its feet again at the new settings
+    qualityGovernor.prepare(sampleRate);
+    qualityLevel = QualityGovernor::fullQuality;
+    synthAudioSource.synth.setVoiceLimit(QualityGovernor::getVoiceLimit(qualityLevel));
+
+    ladderFilter.reset();
+    baseRateLadderFilter.reset();
+    updateFilter(params);
+    ladderFilter.prepare(filterSpec);
+    baseRateLadderFilter.prepare(spec);
 
     reverb.reset();
-    Reverb::Parameters reverbParams;
-    reverbParams.roomSize   = *reverbRoomSize;
-    reverbParams.damping    = *reverbDamping;
-    reverbParams.wetLevel   = *reverbWet;
-    reverbParams.dryLevel   = *reverbDry;
-    reverbParams.freezeMode = *reverbFreeze;
-    reverb.setParameters(reverbParams);
+    updateReverb(params);
     reverb.prepare(spec);
+    fdnReverb.prepare(spec);
+
+    // Also builds the convolution engine for the current impulse response, so this can take a
+    // moment with a long one. It only convolves the channels the bus has, so mono costs half, and
+    // offline it renders its whole tail however fast the host calls processBlock().
+    dsp::ProcessSpec convolutionSpec = spec;
+    convolutionSpec.numChannels = (uint32)jlimit(1, 2, getTotalNumOutputChannels());
+    convolutionReverb.setNonRealtime(isNonRealtime());
+    convolutionReverb.prepare(convolutionSpec);
+    updateTailLength(params);
+
+    silenceDetector.prepare(sampleRate);
+    stageTimings.prepare(sampleRate);
+    xrunDetector.prepare(sampleRate);
+
+    outputGain.reset(sampleRate, 0.02);
+    outputGain.setValue(Decibels::decibelsToGain(params[ParameterSnapshot::output]), true);
+    outputGainRamp.malloc((size_t)effectsBlockSize);
 
     synthAudioSource.prepareToPlay(samplesPerBlock, sampleRate);
 }
 
-void BasicSynth::releaseResources()
+void BasicSynth::setFilterOversampling(int factorLog2, dsp::Oversampling<float>::FilterType type)
+{
+    filterOversamplingFactorLog2 = jlimit(0, 3, factorLog2);
+    filterOversamplingType = type;
+}
+
+void BasicSynth::setFusedOutputStage(bool shouldBeFused)
 {
-    ladderFilter.reset();
+    fusedOutputStage = shouldBeFused;
+}
+
+void BasicSynth::setQualityGovernorEnabled(bool shouldBeEnabled)
+{
+    qualityGovernorEnabled.store(shouldBeEnabled, std::memory_order_relaxed);
+}
+
+void BasicSynth::loadImpulseResponse(const File& file)
+{
+    parameters.state.setProperty(IMPULSE_RESPONSE_FILE, file.getFullPathName(), nullptr);
+    convolutionReverb.loadImpulseResponse(file);
+}
+
+File BasicSynth::getImpulseResponseFile() const
+{
+    return convolutionReverb.getImpulseResponseFile();
+}
+
+void BasicSynth::releaseResources()
+{
+    ladderFilter.reset();
+    baseRateLadderFilter.reset();
+    oversamplingLatency.reset();
+
+    if (filterOversampling != nullptr)
+        filterOversampling->reset();
+
     reverb.reset();
+    fdnReverb.reset();
+    convolutionReverb.release();
+    silenceDetector.reset();
     synthAudioSource.releaseResources();
 }
 
@@ -316,6 +447,21 @@ bool BasicSynth::isBusesLayoutSupported(const BusesLayout& layouts) const
 
 void BasicSynth::processBlock(AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
 {
+    // The filter and reverb states decay towards denormals once a note has finished, and on x86
+    // every operation on a denormal is many times slower. Flushing them to zero for the whole
+    // block keeps a silent tail as cheap as a loud one.
+    ScopedNoDenormals noDenormals;
+
+   #if BASICSYNTH_CHECK_AUDIO_THREAD
+    // Reports any allocation or lock from here on, see AudioThreadChecker.h
+    const AudioThreadChecker::ScopedAudioThread audioThread;
+   #endif
+
+    const TraceRecorder::ScopedEvent trace("processBlock", "samples", buffer.getNumSamples());
+
+    // Everything up to finishBlock() counts against the block's real-time budget
+    const auto blockStartTime = StageTimings::now();
+
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -328,45 +474,275 @@ void BasicSynth::processBlock(AudioBuffer<float>& buffer, MidiBuffer& midiMessag
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    // Request the next audio block from our synthesizer audio source. This will parse the current
-    // MIDI messages and fill the audio buffer with the synthesized audio signal
-    synthAudioSource.getNextAudioBlock(AudioSourceChannelInfo(buffer));
+    // Request the next audio block from our synthesizer audio source. This plays the MIDI the host
+    // sent us along with any notes from the on-screen keyboard or MIDI inputs, and fills the audio
+    // buffer with the synthesized audio signal
+    const auto synthStartTime = StageTimings::now();
+
+    {
+        const TraceRecorder::ScopedEvent synthTrace("Synth", "events", midiMessages.getNumEvents());
+        synthAudioSource.renderNextBlock(buffer, midiMessages, 0, buffer.getNumSamples());
+    }
+
+    // The voices timed themselves as they rendered, the rest of the synth's time went on the MIDI
+    stageTimings.add(StageTimings::midi, StageTimings::now() - synthStartTime
+                                           - stageTimings.getBlockTime(StageTimings::voices));
+
+    // When using juce::dsp classes we have to pass our audio buffer as an AudioBlock
+    dsp::AudioBlock<float> block(buffer);
+
+    // The synth is silent once no voice is playing and the end of the last note, if it finished
+    // in this block, is below the threshold
+    const auto synthIsSilent = ! synthAudioSource.synth.isPlaying()
+                                 && SilenceDetector::isSilent(block);
+
+    // Only the parameters that changed since the last block get passed on to the DSP objects.
+    // This matters most for the drive, as LadderFilter::setDrive() calls std::pow twice. They are
+    // passed on even while idle, so no change is missed.
+    const auto& params = parameterTracker.getNextSnapshot();
+
+    updateFilter(params);
+    updateReverb(params);
+    updateTailLength(params);
+
+    if (params.hasChanged(ParameterSnapshot::output))
+        outputGain.setValue(Decibels::decibelsToGain(params[ParameterSnapshot::output]));
+
+    // With nothing playing and the effects rung out, there is nothing left to process. The synth
+    // still runs above, so that it picks up the next note.
+    if (synthIsSilent && silenceDetector.isIdle())
+    {
+        // Nothing can be heard, so there is no need to ramp to a new output level
+        outputGain.setValue(outputGain.getTargetValue(), true);
+
+        buffer.clear();
+        finishBlock(buffer.getNumSamples(), blockStartTime, params);
+        return;
+    }
+
+    // The effects run in chunks of at most effectsBlockSize samples, each going through the
+    // filter, the reverb and the output gain before the next one starts. With the fused output
+    // stage a chunk is a few kilobytes, so it stays in the L1 cache from one effect to the next
+    // instead of the whole block being streamed through the cache once per effect.
+    const auto numSamples = (int)block.getNumSamples();
+    auto chainIsSilent = synthIsSilent;
+
+    for (auto start = 0; start < numSamples; start += effectsBlockSize)
+    {
+        const auto numThisTime = jmin(effectsBlockSize, numSamples - start);
+        const auto chunkIsSilent = processEffects(block.getSubBlock((size_t)start, (size_t)numThisTime), params);
+
+        chainIsSilent = chainIsSilent && chunkIsSilent;
+    }
+
+    silenceDetector.update(chainIsSilent, numSamples);
+    finishBlock(numSamples, blockStartTime, params);
+}
+
+void BasicSynth::finishBlock(int numSamples, int64 blockStartTime, const ParameterSnapshot& params)
+{
+    const auto& synth = synthAudioSource.synth;
+    stageTimings.finishBlock(numSamples, synth.getNumActiveVoices(), synth.getNumVoiceSteals());
+
+    const auto nanoseconds = StageTimings::now() - blockStartTime;
+
+    xrunDetector.addBlock(nanoseconds, numSamples, synth.getNumActiveVoices(),
+                          synthAudioSource.incomingMidi.getNumEvents(), params.getNumChanged());
+
+    // Shedding a stage that isn't running saves nothing, so the governor skips those levels
+    qualityGovernor.setLevelInUse(QualityGovernor::smallerReverb,
+                                  params[ParameterSnapshot::reverbType] >= 2.0f
+                                    && params[ParameterSnapshot::reverbQuality] >= 0.5f);
+    qualityGovernor.setLevelInUse(QualityGovernor::noFilterOversampling, filterOversampling != nullptr);
+
+    // Offline there is no deadline to keep to, so the quality is only ever lowered in real time
+    if (qualityGovernorEnabled.load(std::memory_order_relaxed) && ! isNonRealtime())
+        qualityGovernor.update(nanoseconds, numSamples);
+    else
+        qualityGovernor.restoreFullQuality();
+
+    applyQualityLevel(qualityGovernor.getLevel(), params);
+}
+
+void BasicSynth::applyQualityLevel(int newLevel, const ParameterSnapshot& params)
+{
+    if (newLevel == qualityLevel)
+        return;
+
+    const auto oldLevel = qualityLevel;
+    qualityLevel = newLevel;
+
+    TraceRecorder::instant("Quality level", "level", newLevel);
+
+    if (QualityGovernor::isReverbReduced(oldLevel) != QualityGovernor::isReverbReduced(newLevel))
+        updateReverbQuality(params);
+
+    // The filter path being switched to starts from silence, which can click, but a click is
+    // better than a dropout and this only happens when the load changes a lot
+    if (QualityGovernor::isFilterOversamplingShed(oldLevel) != QualityGovernor::isFilterOversamplingShed(newLevel))
+    {
+        ladderFilter.reset();
+        baseRateLadderFilter.reset();
+        oversamplingLatency.reset();
+
+        if (filterOversampling != nullptr)
+            filterOversampling->reset();
+    }
+
+    synthAudioSource.synth.setVoiceLimit(QualityGovernor::getVoiceLimit(newLevel));
+}
+
+bool BasicSynth::saveXrunReport(const File& file) const
+{
+    return file.replaceWithText(JSON::toString(xrunDetector.toVar()));
+}
+
+bool BasicSynth::processEffects(dsp::AudioBlock<float> block, const ParameterSnapshot& params)
+{
+    dsp::ProcessContextReplacing<float> context(block);
+
+    {
+        const StageTimings::ScopedStage stage(&stageTimings, StageTimings::filter);
+        const TraceRecorder::ScopedEvent trace("Filter", "samples", (int)block.getNumSamples());
+
+        if (filterOversampling != nullptr && ! QualityGovernor::isFilterOversamplingShed(qualityLevel))
+        {
+            auto oversampledBlock = filterOversampling->processSamplesUp(block);
+            ladderFilter.process(dsp::ProcessContextReplacing<float>(oversampledBlock));
+            filterOversampling->processSamplesDown(block);
+        }
+        else if (filterOversampling != nullptr)
+        {
+            // The quality governor has shed the oversampling, so the filter runs at the base
+            // rate. The delay keeps the latency the host was told about.
+            baseRateLadderFilter.process(context);
+            oversamplingLatency.process(block);
+        }
+        else
+        {
+            ladderFilter.process(context);
+        }
+    }
+
+    {
+        const StageTimings::ScopedStage stage(&stageTimings, StageTimings::reverb);
+        const TraceRecorder::ScopedEvent trace("Reverb", "samples", (int)block.getNumSamples());
+
+        if (params[ParameterSnapshot::reverbType] < 1.0f)
+            reverb.process(context);
+        else if (params[ParameterSnapshot::reverbType] < 2.0f)
+            convolutionReverb.process(context);
+        else
+            fdnReverb.process(context);
+    }
+
+    // Measured before the output gain, so turning that down doesn't cut the tail short
+    const auto isSilent = SilenceDetector::isSilent(block);
+
+    const StageTimings::ScopedStage stage(&stageTimings, StageTimings::gain);
+    const TraceRecorder::ScopedEvent trace("Gain", "samples", (int)block.getNumSamples());
+    applyOutputGain(block);
+
+    return isSilent;
+}
+
+void BasicSynth::applyOutputGain(dsp::AudioBlock<float>& block)
+{
+    if (! outputGain.isSmoothing())
+    {
+        block.multiply(outputGain.getTargetValue());
+        return;
+    }
+
+    // Ramping the gain per sample avoids the zipper noise of a step per block. The ramp is worked
+    // out once and then applied to every channel with a vectorised multiply.
+    const auto numSamples = (int)block.getNumSamples();
+
+    for (auto i = 0; i < numSamples; ++i)
+        outputGainRamp[i] = outputGain.getNextValue();
+
+    for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+        FloatVectorOperations::multiply(block.getChannelPointer(ch), outputGainRamp, numSamples);
+}
+
+void BasicSynth::updateFilter(const ParameterSnapshot& params)
+{
+    // The base rate filter follows every change too, so it's ready whenever the quality governor
+    // switches over to it
+    for (auto* filter : { &ladderFilter, &baseRateLadderFilter })
+    {
+        if (params.hasChanged(ParameterSnapshot::filterMode))
+        {
+            auto mode = params[ParameterSnapshot::filterMode];
+
+            if (mode < 1.0f)
+                filter->setMode(dsp::LadderFilter<float>::Mode::LPF12);
+            else if (mode < 2.0f)
+                filter->setMode(juce::dsp::LadderFilter<float>::Mode::HPF12);
+            else if (mode < 3.0f)
+                filter->setMode(juce::dsp::LadderFilter<float>::Mode::LPF24);
+            else
+                filter->setMode(juce::dsp::LadderFilter<float>::Mode::HPF24);
+        }
+
+        if (params.hasChanged(ParameterSnapshot::filterCutoff))
+            filter->setCutoffFrequencyHz(params[ParameterSnapshot::filterCutoff]);
+
+        if (params.hasChanged(ParameterSnapshot::filterResonance))
+            filter->setResonance(params[ParameterSnapshot::filterResonance]);
+
+        if (params.hasChanged(ParameterSnapshot::filterDrive))
+            filter->setDrive(params[ParameterSnapshot::filterDrive]);
+    }
+}
+
+void BasicSynth::updateReverb(const ParameterSnapshot& params)
+{
+    if (params.hasChanged(ParameterSnapshot::reverbQuality))
+        updateReverbQuality(params);
+
+    // Reverb::setParameters() recalculates all of its filters, so only call it when needed
+    if (! params.hasAnyChanged(ParameterSnapshot::reverbParameters))
+        return;
+
+    Reverb::Parameters reverbParams;
+    reverbParams.roomSize   = params[ParameterSnapshot::reverbRoomSize];
+    reverbParams.damping    = params[ParameterSnapshot::reverbDamping];
+    reverbParams.wetLevel   = params[ParameterSnapshot::reverbWet];
+    reverbParams.dryLevel   = params[ParameterSnapshot::reverbDry];
+    reverbParams.freezeMode = params[ParameterSnapshot::reverbFreeze];
+    reverb.setParameters(reverbParams);
+    fdnReverb.setParameters(reverbParams);
+
+    convolutionReverb.setDryLevel(reverbParams.dryLevel);
+    convolutionReverb.setWetLevel(reverbParams.wetLevel);
+}
+
+void BasicSynth::updateReverbQuality(const ParameterSnapshot& params)
+{
+    // The quality governor can hold the FDN at 8 lines whatever the parameter says
+    const auto useLowQuality = params[ParameterSnapshot::reverbQuality] < 0.5f
+                                 || QualityGovernor::isReverbReduced(qualityLevel);
 
-    // When using juce::dsp classes we have to pass our audio buffer as a ProcessContext
-    dsp::AudioBlock<float> block(buffer);
-    dsp::ProcessContextReplacing<float> context = dsp::ProcessContextReplacing<float>(block);
+    fdnReverb.setQuality(useLowQuality ? FDNReverb::Quality::low : FDNReverb::Quality::high);
+}
 
-    if (lastFilterMode != *filterMode)
-    {
-        if (*filterMode < 1.0f)
-            ladderFilter.setMode(dsp::LadderFilter<float>::Mode::LPF12);
-        else if (*filterMode < 2.0f)
-            ladderFilter.setMode(juce::dsp::LadderFilter<float>::Mode::HPF12);
-        else if (*filterMode < 3.0f)
-            ladderFilter.setMode(juce::dsp::LadderFilter<float>::Mode::LPF24);
-        else
-            ladderFilter.setMode(juce::dsp::LadderFilter<float>::Mode::HPF24);
-
-        lastFilterMode = *filterMode;
-    }
+void BasicSynth::updateTailLength(const ParameterSnapshot& params)
+{
+    auto seconds = 0.0;
+
+    if (params[ParameterSnapshot::reverbType] < 1.0f)
+        seconds = reverb.getTailLengthSeconds();
+    else if (params[ParameterSnapshot::reverbType] < 2.0f)
+        seconds = convolutionReverb.getTailLengthSeconds();
+    else
+        seconds = fdnReverb.getTailLengthSeconds();
+
+    // Hosts keep processing for as long as this after the input stops, so a frozen reverb's
+    // endless tail is reported as a long one instead
+    tailLengthSeconds.store(jmin(seconds, maxTailLengthSeconds), std::memory_order_relaxed);
+}
 
-    ladderFilter.setCutoffFrequencyHz(*filterCutoff);
-    ladderFilter.setResonance(*filterResonance);
-    ladderFilter.setDrive(*filterDrive);
-    ladderFilter.process(context);
-
-    Reverb::Parameters reverbParams;
-    reverbParams.roomSize   = *reverbRoomSize;
-    reverbParams.damping    = *reverbDamping;
-    reverbParams.wetLevel   = *reverbWet;
-    reverbParams.dryLevel   = *reverbDry;
-    reverbParams.freezeMode = *reverbFreeze;
-    reverb.setParameters(reverbParams);
-    reverb.process(context);
-
-    buffer.applyGain(Decibels::decibelsToGain(*output));
-}
-
 bool BasicSynth::hasEditor() const
 {
     return true; // (change this to false if you choose to not supply an editor)
@@ -392,7 +768,14 @@ void BasicSynth::setStateInformation(const void* data, int sizeInBytes)
 
     if (xml.get() != nullptr)
         if (xml->hasTagName(parameters.state.getType().toString()))
+        {
             parameters.replaceState(ValueTree::fromXml(*xml));
+
+            const File file(parameters.state.getProperty(IMPULSE_RESPONSE_FILE).toString());
+
+            if (file.existsAsFile())
+                convolutionReverb.loadImpulseResponse(file);
+        }
 }
 
 //==============================================================================
@@ -3,6 +3,14 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 
 #include "Synth.h"
+#include "ParameterSnapshot.h"
+#include "SIMDReverb.h"
+#include "ConvolutionReverb.h"
+#include "FDNReverb.h"
+#include "SilenceDetector.h"
+#include "XrunDetector.h"
+#include "QualityGovernor.h"
+#include "SampleDelay.h"
 
 struct BasicSynth  : public AudioProcessor
 {
@@ -17,9 +25,14 @@ struct BasicSynth  : public AudioProcessor
     static const StringRef REVERB_FREEZE;
     static const StringRef REVERB_DRY;
     static const StringRef REVERB_WET;
+    static const StringRef REVERB_TYPE;
+    static const StringRef REVERB_QUALITY;
 
     static const StringRef OUTPUT;
 
+    // Not a parameter, but saved with them in the plugin's state
+    static const Identifier IMPULSE_RESPONSE_FILE;
+
     // =============================================================================================
 
     BasicSynth();
@@ -52,27 +65,114 @@ struct BasicSynth  : public AudioProcessor
 
     void getStateInformation (MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
+
+    // Runs the filter at 2^factorLog2 times the sample rate (0 turns oversampling off) so that the
+    // saturation from its drive doesn't alias. The polyphase IIR filters are the cheaper tier and
+    // add less latency, the FIR filters are linear phase. Takes effect on the next prepareToPlay(),
+    // which also reports the added latency to the host.
+    void setFilterOversampling (int factorLog2, dsp::Oversampling<float>::FilterType type);
+
+    // Runs the filter, reverb and output gain over sub-blocks of fusedBlockSize samples instead of
+    // passing the whole block through each in turn, see processBlock(). On by default. Takes effect
+    // on the next prepareToPlay().
+    void setFusedOutputStage (bool shouldBeFused);
+
+    // Lets the quality governor lower the quality when processBlock() runs short of time, see
+    // QualityGovernor.h. On by default, though it never acts while rendering offline. Turning it
+    // off restores full quality on the next block. Can be called while playing.
+    void setQualityGovernorEnabled (bool shouldBeEnabled);
+
+    // Loads an impulse response for the convolution reverb. The file is read and prepared in the
+    // background, and is remembered with the plugin's state.
+    void loadImpulseResponse (const File& file);
+    File getImpulseResponseFile() const;
+
+    // Apply the parameters that changed in this snapshot to the DSP objects
+    void updateFilter (const ParameterSnapshot& params);
+    void updateReverb (const ParameterSnapshot& params);
+    void updateReverbQuality (const ParameterSnapshot& params);
+
+    // Works out the tail reported by getTailLengthSeconds() from the current reverb
+    void updateTailLength (const ParameterSnapshot& params);
+
+    // Runs the filter, the reverb and the output gain on one chunk of the block. Returns true if
+    // the chunk was silent before the output gain.
+    bool processEffects (dsp::AudioBlock<float> block, const ParameterSnapshot& params);
+    void applyOutputGain (dsp::AudioBlock<float>& block);
+
+    // Publishes the block's stage timings and voice counts for the editor, and checks how long
+    // the block took against its real-time budget
+    void finishBlock (int numSamples, int64 blockStartTime, const ParameterSnapshot& params);
+
+    // Switches the reverb, the filter and the voice limit over to a QualityGovernor level
+    void applyQualityLevel (int newLevel, const ParameterSnapshot& params);
+
+    // Writes the block time histogram and the worst blocks so far as JSON, see XrunDetector.h.
+    // Can be called while playing.
+    bool saveXrunReport (const File& file) const;
+
+    // Declared before the synth, which listens to it from its constructor
+    MidiKeyboardState keyboardState;
 
     SynthAudioSource synthAudioSource;
 
     dsp::LadderFilter<float> ladderFilter;
-    dsp::Reverb reverb;
+
+    ScopedPointer<dsp::Oversampling<float>> filterOversampling;
+    int filterOversamplingFactorLog2 = 0;
+    dsp::Oversampling<float>::FilterType filterOversamplingType = dsp::Oversampling<float>::filterHalfBandPolyphaseIIR;
+
+    // Stand in for the oversampled filter while the quality governor has shed the oversampling,
+    // delayed by as much as the oversampling would have been
+    dsp::LadderFilter<float> baseRateLadderFilter;
+    SampleDelay oversamplingLatency;
+
+    // The same reverb as dsp::Reverb with its comb filters in SIMD lanes, see SIMDReverb.h
+    SIMDReverb reverb;
+
+    // Used instead of the algorithmic reverb when the reverb type is set to convolution
+    ConvolutionReverb convolutionReverb;
+
+    // A feedback delay network with 8 or 16 lines, depending on the reverb quality
+    FDNReverb fdnReverb;
 
     AudioProcessorValueTreeState parameters;
 
-    float *filterMode,
-          *filterCutoff,
-          *filterResonance,
-          *filterDrive,
-          *reverbRoomSize,
-          *reverbDamping,
-          *reverbWidth,
-          *reverbFreeze,
-          *reverbDry,
-          *reverbWet,
-          *output;
-
-    float lastFilterMode;
-
-    MidiKeyboardState keyboardState;
+    // Gives processBlock a consistent copy of the parameters once per block, see ParameterSnapshot.h
+    ParameterTracker parameterTracker;
+
+    // 256 stereo samples are 2 KB, or 16 KB at the filter's 8x oversampling, which leaves room in
+    // a 32 KB L1 cache for the filter and reverb state
+    static constexpr int fusedBlockSize = 256;
+    bool fusedOutputStage = true;
+    int effectsBlockSize = 512;
+
+    LinearSmoothedValue<float> outputGain;
+    HeapBlock<float> outputGainRamp;
+
+    // Skips the effects once everything has gone quiet, see SilenceDetector.h
+    SilenceDetector silenceDetector;
+
+    // How long each stage of processBlock() takes, shown by the editor's CPU meter
+    StageTimings stageTimings;
+
+    // Finds the blocks that took longer than their real-time budget, see XrunDetector.h
+    XrunDetector xrunDetector;
+
+    // Sheds quality before blocks start running late, see QualityGovernor.h. qualityLevel is the
+    // level last applied, and only the audio thread touches it. The log runs on a timer, so it is
+    // only made when a plugin wrapper creates us, not in the command line tools.
+    QualityGovernor qualityGovernor;
+    ScopedPointer<QualityGovernorLog> qualityGovernorLog;
+    std::atomic<bool> qualityGovernorEnabled { true };
+    int qualityLevel = QualityGovernor::fullQuality;
+
+   #if BASICSYNTH_TRACE
+    // Writes the timeline of this and any other instance to a file, see TraceRecorder.h
+    SharedResourcePointer<TraceRecorder> traceRecorder;
+   #endif
+
+    // Written by the audio thread, read by the host from any thread
+    static constexpr double maxTailLengthSeconds = 60.0;
+    std::atomic<double> tailLengthSeconds { 0.0 };
 };
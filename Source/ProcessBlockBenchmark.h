@@ -0,0 +1,364 @@
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "PluginProcessor.h"
+#include "AllocationCounter.h"
+
+// Times BasicSynth::processBlock() end to end, the way a host calls it. This is what the
+// benchmark tool runs, see BenchmarkMain.cpp.
+//
+// Each case sets up a fresh synth with one configuration, holds down as many notes as it has
+// voices and keeps retriggering them, so every voice is always sounding and the MIDI and voice
+// stealing paths are exercised too. After a warm-up that also fills the reverb, every block is
+// timed on its own. The results are the average cost per sample, the median, 99th percentile and
+// worst block times, and how many heap allocations the audio thread made per block (which should
+// be 0).
+struct ProcessBlockBenchmark
+{
+    struct Config
+    {
+        double sampleRate = 48000.0;
+        int blockSize = 512;
+        int numVoices = 16;
+
+        // As the parameters: 0 to 3 are Lowpass 12dB, Highpass 12dB, Lowpass 24dB, Highpass 24dB
+        int filterMode = 2;
+
+        // 0 is the algorithmic reverb, 1 convolution, 2 the FDN. Quality 0 is the 8 line FDN.
+        int reverbType = 0;
+        int reverbQuality = 1;
+        float roomSize = 0.5f;
+
+        // Identifies the case in the JSON and when comparing with a baseline
+        String getName() const
+        {
+            static const char* const filterNames[] = { "lp12", "hp12", "lp24", "hp24" };
+            static const char* const reverbNames[] = { "simd", "conv", "fdn" };
+
+            auto reverb = String(reverbNames[jlimit(0, 2, reverbType)]);
+
+            if (reverbType == 2)
+                reverb << (reverbQuality == 0 ? "8" : "16");
+
+            return "sr" + String(roundToInt(sampleRate)) + "_bs" + String(blockSize)
+                   + "_v" + String(numVoices) + "_" + filterNames[jlimit(0, 3, filterMode)]
+                   + "_" + reverb + "_room" + String(roundToInt(roomSize * 100.0f));
+        }
+    };
+
+    struct Result
+    {
+        Config config;
+        int numBlocks = 0;
+
+        double nsPerSample = 0.0;
+        double medianBlockMs = 0.0, p99BlockMs = 0.0, maxBlockMs = 0.0;
+
+        // The fraction of the real time budget the median block uses
+        double medianLoad = 0.0;
+
+        double allocationsPerBlock = 0.0;
+
+        var toVar() const
+        {
+            auto* object = new DynamicObject();
+
+            object->setProperty("name", config.getName());
+            object->setProperty("sampleRate", config.sampleRate);
+            object->setProperty("blockSize", config.blockSize);
+            object->setProperty("voices", config.numVoices);
+            object->setProperty("filterMode", config.filterMode);
+            object->setProperty("reverbType", config.reverbType);
+            object->setProperty("reverbQuality", config.reverbQuality);
+            object->setProperty("roomSize", config.roomSize);
+            object->setProperty("blocks", numBlocks);
+            object->setProperty("nsPerSample", nsPerSample);
+            object->setProperty("p50BlockMs", medianBlockMs);
+            object->setProperty("p99BlockMs", p99BlockMs);
+            object->setProperty("maxBlockMs", maxBlockMs);
+            object->setProperty("p50Load", medianLoad);
+            object->setProperty("allocationsPerBlock", allocationsPerBlock);
+
+            return var(object);
+        }
+    };
+
+    static constexpr double warmUpSeconds = 0.5;
+
+    // Notes are retriggered this often, one at a time in turn
+    static constexpr double retriggerSeconds = 0.05;
+
+    // The convolution reverb needs an impulse response, and nothing is loaded by default. Cases
+    // with the convolution reverb use this file, see createImpulseResponse().
+    File impulseResponseFile;
+
+    Result run(const Config& config, double secondsToTime) const
+    {
+        BasicSynth synth;
+        setUp(synth, config);
+
+        AudioBuffer<float> buffer(2, config.blockSize);
+        MidiBuffer midi;
+        midi.ensureSize(4096);
+
+        auto note = 0;
+        auto nextRetrigger = 0;
+        const auto retriggerSamples = jmax(1, roundToInt(retriggerSeconds * config.sampleRate));
+
+        // Everything that allocates, the buffer of block times included, is done before timing
+        const auto numWarmUpBlocks = jmax(1, (int)(warmUpSeconds * config.sampleRate) / config.blockSize);
+        const auto numBlocks = jmax(1, (int)(secondsToTime * config.sampleRate) / config.blockSize);
+
+        HeapBlock<int64> blockTicks((size_t)numBlocks);
+        int64 allocations = 0;
+
+        for (auto i = -numWarmUpBlocks; i < numBlocks; ++i)
+        {
+            midi.clear();
+
+            if (i == -numWarmUpBlocks)
+                for (auto v = 0; v < config.numVoices; ++v)
+                    midi.addEvent(MidiMessage::noteOn(1, getNoteNumber(v), 0.5f), 0);
+
+            // nextRetrigger counts from the start of this block
+            for (; nextRetrigger < config.blockSize; nextRetrigger += retriggerSamples)
+            {
+                const auto noteNumber = getNoteNumber(note);
+
+                midi.addEvent(MidiMessage::noteOff(1, noteNumber), nextRetrigger);
+                midi.addEvent(MidiMessage::noteOn(1, noteNumber, 0.5f), nextRetrigger);
+
+                note = (note + 1) % config.numVoices;
+            }
+
+            nextRetrigger -= config.blockSize;
+
+            buffer.clear();
+
+            const auto allocationsBefore = AllocationCounter::getThreadCount();
+            const auto start = Time::getHighResolutionTicks();
+
+            synth.processBlock(buffer, midi);
+
+            const auto end = Time::getHighResolutionTicks();
+
+            if (i >= 0)
+            {
+                blockTicks[i] = end - start;
+                allocations += AllocationCounter::getThreadCount() - allocationsBefore;
+            }
+        }
+
+        std::sort(blockTicks.get(), blockTicks.get() + numBlocks);
+
+        const auto ticksToMs = 1000.0 / (double)Time::getHighResolutionTicksPerSecond();
+        const auto budgetMs = 1000.0 * config.blockSize / config.sampleRate;
+        int64 totalTicks = 0;
+
+        for (auto i = 0; i < numBlocks; ++i)
+            totalTicks += blockTicks[i];
+
+        Result result;
+        result.config = config;
+        result.numBlocks = numBlocks;
+        result.nsPerSample = totalTicks * ticksToMs * 1.0e6 / ((double)numBlocks * config.blockSize);
+        result.medianBlockMs = blockTicks[numBlocks / 2] * ticksToMs;
+        result.p99BlockMs = blockTicks[jmin(numBlocks - 1, (numBlocks * 99) / 100)] * ticksToMs;
+        result.maxBlockMs = blockTicks[numBlocks - 1] * ticksToMs;
+        result.medianLoad = result.medianBlockMs / budgetMs;
+        result.allocationsPerBlock = (double)allocations / numBlocks;
+
+        return result;
+    }
+
+    // Varies one setting at a time from the default Config
+    static Array<Config> getQuickSweep()
+    {
+        const Config base;
+        Array<Config> configs { base };
+
+        for (auto sampleRate : { 44100.0, 96000.0, 192000.0 })
+        {
+            auto config = base;
+            config.sampleRate = sampleRate;
+            configs.add(config);
+        }
+
+        for (auto blockSize : { 16, 64, 128, 256, 1024, 4096 })
+        {
+            auto config = base;
+            config.blockSize = blockSize;
+            configs.add(config);
+        }
+
+        for (auto numVoices : { 1, 4, 64 })
+        {
+            auto config = base;
+            config.numVoices = numVoices;
+            configs.add(config);
+        }
+
+        for (auto filterMode : { 0, 1, 3 })
+        {
+            auto config = base;
+            config.filterMode = filterMode;
+            configs.add(config);
+        }
+
+        for (auto roomSize : { 0.0f, 1.0f })
+        {
+            auto config = base;
+            config.roomSize = roomSize;
+            configs.add(config);
+        }
+
+        for (auto reverb : { 1, 2, 3 })
+        {
+            auto config = base;
+            config.reverbType = jmin(reverb, 2);
+            config.reverbQuality = reverb == 2 ? 0 : 1;
+            configs.add(config);
+        }
+
+        return configs;
+    }
+
+    // Every combination. This takes a while.
+    static Array<Config> getFullSweep()
+    {
+        Array<Config> configs;
+
+        for (auto sampleRate : { 44100.0, 48000.0, 96000.0, 192000.0 })
+            for (auto blockSize : { 16, 64, 256, 1024, 4096 })
+                for (auto numVoices : { 1, 16, 64 })
+                    for (auto filterMode : { 0, 2 })
+                        for (auto reverb : { 0, 1, 2, 3 })
+                        {
+                            Config config;
+                            config.sampleRate = sampleRate;
+                            config.blockSize = blockSize;
+                            config.numVoices = numVoices;
+                            config.filterMode = filterMode;
+                            config.reverbType = jmin(reverb, 2);
+                            config.reverbQuality = reverb == 2 ? 0 : 1;
+                            configs.add(config);
+                        }
+
+        return configs;
+    }
+
+    // Writes two seconds of decaying noise, which is about what a real hall response costs
+    static bool createImpulseResponse(const File& file)
+    {
+        const auto sampleRate = 48000.0;
+        AudioBuffer<float> impulse(2, (int)(2.0 * sampleRate));
+        Random random(1);
+
+        for (auto ch = 0; ch < impulse.getNumChannels(); ++ch)
+            for (auto i = 0; i < impulse.getNumSamples(); ++i)
+                impulse.setSample(ch, i, (random.nextFloat() * 2.0f - 1.0f)
+                                           * std::exp(-6.9f * (float)i / impulse.getNumSamples()));
+
+        file.deleteFile();
+        ScopedPointer<FileOutputStream> stream(file.createOutputStream());
+
+        if (stream == nullptr)
+            return false;
+
+        WavAudioFormat format;
+        ScopedPointer<AudioFormatWriter> writer(format.createWriterFor(stream, sampleRate, 2, 32, {}, 0));
+
+        if (writer == nullptr)
+            return false;
+
+        stream.release();
+        return writer->writeFromAudioSampleBuffer(impulse, 0, impulse.getNumSamples());
+    }
+
+    // Checks the results against a baseline written by an earlier run. A case regresses if its
+    // time per sample grew by more than the tolerance (0.1 is 10%), or if it allocates more than
+    // it did. Cases missing from either side are skipped. Returns a line for each regression.
+    static StringArray compareWithBaseline(const Array<Result>& results, const var& baseline, double tolerance)
+    {
+        StringArray regressions;
+
+        if (auto* baselineResults = baseline["results"].getArray())
+        {
+            for (auto& result : results)
+            {
+                const auto name = result.config.getName();
+
+                for (auto& old : *baselineResults)
+                {
+                    if (old["name"].toString() != name)
+                        continue;
+
+                    const auto oldNsPerSample = (double)old["nsPerSample"];
+                    const auto oldAllocations = (double)old["allocationsPerBlock"];
+
+                    if (result.nsPerSample > oldNsPerSample * (1.0 + tolerance))
+                        regressions.add(name + ": " + String(result.nsPerSample, 2) + " ns/sample, was "
+                                        + String(oldNsPerSample, 2) + " (+"
+                                        + String((result.nsPerSample / oldNsPerSample - 1.0) * 100.0, 1) + "%)");
+
+                    if (result.allocationsPerBlock > oldAllocations)
+                        regressions.add(name + ": " + String(result.allocationsPerBlock, 2)
+                                        + " allocations per block, was " + String(oldAllocations, 2));
+                    break;
+                }
+            }
+        }
+
+        return regressions;
+    }
+
+    static var toVar(const Array<Result>& results)
+    {
+        Array<var> list;
+
+        for (auto& result : results)
+            list.add(result.toVar());
+
+        auto* object = new DynamicObject();
+        object->setProperty("cpu", SystemStats::getCpuModel());
+        object->setProperty("numCpus", SystemStats::getNumCpus());
+        object->setProperty("date", Time::getCurrentTime().toISO8601(true));
+        object->setProperty("allocationsCounted", AllocationCounter::isAvailable());
+        object->setProperty("results", list);
+
+        return var(object);
+    }
+
+private:
+    void setUp(BasicSynth& synth, const Config& config) const
+    {
+        auto setParameter = [&synth](StringRef parameterID, float value)
+        {
+            const auto range = synth.parameters.getParameterRange(parameterID);
+            synth.parameters.getParameter(parameterID)->setValueNotifyingHost(range.convertTo0to1(value));
+        };
+
+        setParameter(BasicSynth::FILTER_MODE, (float)config.filterMode);
+        setParameter(BasicSynth::REVERB_TYPE, (float)config.reverbType);
+        setParameter(BasicSynth::REVERB_QUALITY, (float)config.reverbQuality);
+        setParameter(BasicSynth::REVERB_ROOM_SIZE, config.roomSize);
+
+        if (config.reverbType == 1)
+            synth.loadImpulseResponse(impulseResponseFile);
+
+        synth.synthAudioSource.setPolyphony(config.numVoices);
+
+        // Timing the full quality is the point, so the governor mustn't shed any of it
+        synth.setQualityGovernorEnabled(false);
+
+        synth.setPlayConfigDetails(0, 2, config.sampleRate, config.blockSize);
+        synth.prepareToPlay(config.sampleRate, config.blockSize);
+    }
+
+    // Spread over eight octaves from C0, so the voices don't all read the same part of the sine
+    // table. Up to 96 voices get a note of their own.
+    static int getNoteNumber(int voice) noexcept
+    {
+        return 12 + (voice * 7) % 96;
+    }
+};
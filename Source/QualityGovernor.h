@@ -0,0 +1,281 @@
+#pragma once
+
+// Lowers the synth's quality a step at a time when processBlock() starts using too much of its
+// real-time budget, and raises it again once there is room, so that a busy machine gets a
+// slightly duller sound instead of dropouts.
+//
+// The steps are cumulative, cheapest to hear first: the FDN reverb drops to 8 delay lines, the
+// filter stops oversampling, and then the number of notes that can be held is capped at three
+// quarters, a half and finally a quarter of the voices. BasicSynth applies them, see
+// BasicSynth::applyQualityLevel(). A step only saves time if its part of the synth is in use, so
+// BasicSynth says which are with setLevelInUse() and the rest are skipped over: with the
+// algorithmic reverb and no oversampling, the first step goes straight to the voice limit.
+//
+// Each block's load is its time divided by its budget, as in XrunDetector. Quality drops a step
+// when the load, smoothed over about smoothingSeconds, goes over stepDownLoad, or straight away
+// when a block runs late. It comes back a step once the smoothed load has stayed under
+// stepUpLoad for the step-up hold. The gap between the two loads and the holds keep it from
+// flapping between two steps: a step taken after stepDownHoldSeconds has time to show in the
+// smoothed load, and if raising the quality pushes the load straight back up, the step-up hold
+// doubles each time, up to maxStepUpHoldSeconds.
+//
+// update() runs on the audio thread and never waits. Its decisions go into a small ring that the
+// message thread reads, see QualityGovernorLog, and the current level is an atomic for the editor.
+// Like XrunDetector's worst blocks, a decision is checked again after it has been copied, and
+// dropped if the audio thread reused its slot in the meantime.
+struct QualityGovernor
+{
+    enum Level
+    {
+        fullQuality,
+        smallerReverb,
+        noFilterOversampling,
+        threeQuarterVoices,
+        halfVoices,
+        quarterVoices,
+        numLevels
+    };
+
+    static const char* getLevelName(int level) noexcept
+    {
+        switch (level)
+        {
+            case fullQuality:           return "full quality";
+            case smallerReverb:         return "8 line FDN reverb";
+            case noFilterOversampling:  return "filter not oversampled";
+            case threeQuarterVoices:    return "3/4 of the voices";
+            case halfVoices:            return "1/2 of the voices";
+            case quarterVoices:         return "1/4 of the voices";
+            default:                    return "";
+        }
+    }
+
+    static bool isReverbReduced(int level) noexcept             { return level >= smallerReverb; }
+    static bool isFilterOversamplingShed(int level) noexcept    { return level >= noFilterOversampling; }
+
+    // The proportion of the voices that can be held at this level
+    static float getVoiceLimit(int level) noexcept
+    {
+        return level >= quarterVoices ? 0.25f
+             : level >= halfVoices ? 0.5f
+             : level >= threeQuarterVoices ? 0.75f
+             : 1.0f;
+    }
+
+    static constexpr float stepDownLoad = 0.7f, stepUpLoad = 0.4f;
+    static constexpr double smoothingSeconds = 0.1;
+    static constexpr double stepDownHoldSeconds = 0.25, stepUpHoldSeconds = 2.0, maxStepUpHoldSeconds = 30.0;
+
+    // Why a decision was taken
+    enum Reason
+    {
+        highLoad,
+        lateBlock,
+        lowLoad,
+        turnedOff
+    };
+
+    struct Decision
+    {
+        double seconds = 0.0;   // since the governor was created, in audio time
+        int level = fullQuality;
+        Reason reason = highLoad;
+        float load = 0.0f;      // smoothed, or the late block's own
+
+        String toString() const
+        {
+            String text;
+            text << "At " << String(seconds, 2) << " s, quality ";
+
+            switch (reason)
+            {
+                case highLoad:  text << "lowered, load " << roundToInt(load * 100.0f) << "%"; break;
+                case lateBlock: text << "lowered, a block took " << roundToInt(load * 100.0f) << "% of its budget"; break;
+                case lowLoad:   text << "raised, load " << roundToInt(load * 100.0f) << "%"; break;
+                case turnedOff: text << "restored, governor turned off"; break;
+                default:        break;
+            }
+
+            return text << ", now " << getLevelName(level);
+        }
+    };
+
+    // Starts again at full quality
+    void prepare(double newSampleRate) noexcept
+    {
+        sampleRate = newSampleRate;
+        smoothedLoad = 0.0f;
+        secondsAtLowLoad = 0.0;
+        stepUpHold = stepUpHoldSeconds;
+        level.store(fullQuality, std::memory_order_relaxed);
+    }
+
+    // Says whether a level's part of the synth is in use, so that stepping to it would save
+    // anything. Levels not in use are skipped. The voice limits are always in use.
+    void setLevelInUse(int levelToSet, bool isInUse) noexcept
+    {
+        jassert(levelToSet > fullQuality && levelToSet < threeQuarterVoices);
+
+        const auto bit = 1u << levelToSet;
+        unusedLevels = isInUse ? (unusedLevels & ~bit) : (unusedLevels | bit);
+    }
+
+    // Call from the audio thread at the end of every block, with how long it took
+    void update(int64 nanoseconds, int numSamples) noexcept
+    {
+        if (sampleRate <= 0.0 || numSamples <= 0)
+            return;
+
+        const auto blockSeconds = numSamples / sampleRate;
+        const auto load = (float)((double)nanoseconds * 1.0e-9 / blockSeconds);
+
+        // One-pole smoothing, weighted by the block's length so the time constant doesn't depend
+        // on the block size
+        smoothedLoad += (load - smoothedLoad) * (float)(1.0 - std::exp(-blockSeconds / smoothingSeconds));
+
+        audioSeconds += blockSeconds;
+        secondsAtLowLoad = smoothedLoad < stepUpLoad ? secondsAtLowLoad + blockSeconds : 0.0;
+
+        const auto current = getLevel();
+
+        if (current < numLevels - 1 && audioSeconds - lastChangeSeconds >= stepDownHoldSeconds
+             && (load > 1.0f || smoothedLoad > stepDownLoad))
+        {
+            // Raising the quality didn't last, so wait longer before trying again
+            stepUpHold = audioSeconds - lastStepUpSeconds < stepUpHold ? jmin(stepUpHold * 2.0, maxStepUpHoldSeconds)
+                                                                       : stepUpHoldSeconds;
+
+            if (load > 1.0f)
+                changeLevel(getNextLevel(current, 1), lateBlock, load);
+            else
+                changeLevel(getNextLevel(current, 1), highLoad, smoothedLoad);
+        }
+        else if (current > fullQuality && secondsAtLowLoad >= stepUpHold)
+        {
+            lastStepUpSeconds = audioSeconds;
+            changeLevel(getNextLevel(current, -1), lowLoad, smoothedLoad);
+        }
+    }
+
+    // Goes straight back to full quality, for when the governor is turned off. Audio thread only.
+    void restoreFullQuality() noexcept
+    {
+        if (getLevel() != fullQuality)
+            changeLevel(fullQuality, turnedOff, smoothedLoad);
+    }
+
+    // The rest can be called from any thread
+
+    int getLevel() const noexcept
+    {
+        return level.load(std::memory_order_relaxed);
+    }
+
+    // Fetches the oldest decision not yet read, or returns false if there are none. Only one
+    // thread may read the decisions.
+    bool readNextDecision(Decision& decision) noexcept
+    {
+        for (;;)
+        {
+            const auto numWritten = numDecisions.load(std::memory_order_acquire);
+
+            // Skip any decisions whose slots the audio thread has already reused. At no more than
+            // one decision every stepDownHoldSeconds, that takes 16 seconds without a read.
+            if (numWritten - numRead > (uint64)maxDecisions)
+                numRead = numWritten - (uint64)maxDecisions;
+
+            if (numRead == numWritten)
+                return false;
+
+            decision = decisions[numRead % maxDecisions];
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            // The audio thread starts on decision numRead + maxDecisions, in the same slot, only
+            // after publishing the one before it
+            if (numDecisions.load(std::memory_order_relaxed) - numRead < (uint64)maxDecisions)
+            {
+                ++numRead;
+                return true;
+            }
+        }
+    }
+
+private:
+    static constexpr int maxDecisions = 64;
+
+    // The next level down (direction 1) or up (-1) that would change anything
+    int getNextLevel(int from, int direction) const noexcept
+    {
+        auto next = from + direction;
+
+        while (next > fullQuality && next < threeQuarterVoices && (unusedLevels & (1u << next)) != 0)
+            next += direction;
+
+        return next;
+    }
+
+    void changeLevel(int newLevel, Reason reason, float load) noexcept
+    {
+        // Whichever way it went, the load has to prove itself low again at the new level
+        lastChangeSeconds = audioSeconds;
+        secondsAtLowLoad = 0.0;
+        level.store(newLevel, std::memory_order_relaxed);
+
+        // Keeps the slot's new contents from showing before the last decision was published,
+        // see readNextDecision()
+        const auto index = numDecisions.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        auto& decision = decisions[index % maxDecisions];
+
+        decision.seconds = audioSeconds;
+        decision.level = newLevel;
+        decision.reason = reason;
+        decision.load = load;
+
+        numDecisions.store(index + 1, std::memory_order_release);
+    }
+
+    // Only touched by the audio thread
+    double sampleRate = 0.0;
+    double audioSeconds = 0.0, lastChangeSeconds = 0.0, lastStepUpSeconds = -maxStepUpHoldSeconds;
+    double secondsAtLowLoad = 0.0, stepUpHold = stepUpHoldSeconds;
+    float smoothedLoad = 0.0f;
+    uint32 unusedLevels = 0;
+
+    std::atomic<int> level { fullQuality };
+
+    Decision decisions[maxDecisions];
+    std::atomic<uint64> numDecisions { 0 };
+    uint64 numRead = 0;
+};
+
+// Writes a QualityGovernor's decisions to the JUCE Logger from the message thread, so they show
+// up in the host's log or on the console
+struct QualityGovernorLog : private Timer
+{
+    static constexpr int intervalMs = 500;
+
+    QualityGovernorLog(QualityGovernor& g) : governor(g)
+    {
+        startTimer(intervalMs);
+    }
+
+    ~QualityGovernorLog()
+    {
+        stopTimer();
+    }
+
+private:
+    void timerCallback() override
+    {
+        QualityGovernor::Decision decision;
+
+        while (governor.readNextDecision(decision))
+            Logger::writeToLog("BasicSynth: " + decision.toString());
+    }
+
+    QualityGovernor& governor;
+
+    JUCE_DECLARE_NON_COPYABLE(QualityGovernorLog)
+};
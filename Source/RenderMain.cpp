@@ -0,0 +1,161 @@
+// A command line tool that renders MIDI files through BasicSynth without a GUI or audio device.
+// Built by the Render target of Builds/LinuxMakefile/Tools.mk ("make -f Tools.mk Render"), it
+// isn't part of the plugin.
+//
+//   BasicSynthRender [options] input.mid output.wav|output.flac
+//   BasicSynthRender [options] --batch manifest.txt
+//
+// The batch mode renders every job in the manifest in parallel, see BatchRenderer.h for its
+// format. The other options apply to every job.
+//
+// The state file is the XML the plugin saves its parameters as. Each --set is applied after it,
+// with the value in the parameter's own units, for example --set filter_cutoff=800.
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "BatchRenderer.h"
+
+#include <iostream>
+
+static void printUsage()
+{
+    std::cout << "Usage: BasicSynthRender [options] input.mid output.wav|output.flac" << std::endl
+              << "       BasicSynthRender [options] --batch manifest.txt" << std::endl
+              << std::endl
+              << "  --sample-rate <hz>      default 48000" << std::endl
+              << "  --block-size <samples>  default 512" << std::endl
+              << "  --voices <count>        default 16" << std::endl
+              << "  --bits <16|24|32>       default 24 (32 is float, WAV only)" << std::endl
+              << "  --tail <seconds>        time to render after the last event, default the synth's tail" << std::endl
+              << "  --state <file.xml>      parameter state saved by the plugin" << std::endl
+              << "  --set <id>=<value>      sets a parameter, can be repeated" << std::endl
+              << "  --batch <manifest>      renders a list of jobs, one per line: input, state (or -), output" << std::endl
+              << "  --threads <count>       worker threads for --batch, default one per core" << std::endl;
+}
+
+static String describe(const OfflineRenderer::Stats& stats)
+{
+    return String(stats.audioSeconds, 2) + " s of audio in " + String(stats.renderSeconds, 3)
+           + " s (" + String(stats.getRealtimeMultiple(), 1) + "x realtime)";
+}
+
+static int renderBatch(const File& manifest, const OfflineRenderer::Settings& settings, int numThreads)
+{
+    OwnedArray<BatchRenderer::Job> jobs;
+    const auto result = BatchRenderer::readManifest(manifest, jobs);
+
+    if (result.failed())
+    {
+        std::cerr << result.getErrorMessage() << std::endl;
+        return 1;
+    }
+
+    BatchRenderer renderer(settings, numThreads);
+
+    renderer.onJobFinished = [](const BatchRenderer::Job& job)
+    {
+        if (job.result.failed())
+            std::cerr << job.midiFile.getFileName() << ": " << job.result.getErrorMessage() << std::endl;
+        else
+            std::cout << job.outputFile.getFileName() << ": " << describe(job.stats) << std::endl;
+    };
+
+    const auto stats = renderer.run(jobs);
+
+    std::cout << "Rendered " << stats.numJobs - stats.numFailed << " of " << stats.numJobs << " jobs, "
+              << String(stats.audioSeconds, 2) << " s of audio in " << String(stats.wallSeconds, 3)
+              << " s on " << jmin(numThreads, stats.numJobs) << " threads ("
+              << String(stats.getRealtimeMultiple(), 1) << "x realtime)" << std::endl;
+
+    return stats.numFailed == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    // The plugin's parameters start timers, which need a message manager even though no messages
+    // are ever dispatched here
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    OfflineRenderer::Settings settings;
+    StringArray files;
+    File manifest;
+    auto numThreads = SystemStats::getNumCpus();
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        const auto arg = String::fromUTF8(argv[i]);
+        const auto hasValue = i + 1 < argc;
+
+        if (arg == "--help" || arg == "-h")
+        {
+            printUsage();
+            return 0;
+        }
+
+        if (! arg.startsWith("--"))
+        {
+            files.add(arg);
+            continue;
+        }
+
+        if (! hasValue)
+        {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+
+        const auto value = String::fromUTF8(argv[++i]);
+
+        if (arg == "--sample-rate")
+            settings.sampleRate = value.getDoubleValue();
+        else if (arg == "--block-size")
+            settings.blockSize = value.getIntValue();
+        else if (arg == "--voices")
+            settings.numVoices = value.getIntValue();
+        else if (arg == "--bits")
+            settings.bitsPerSample = value.getIntValue();
+        else if (arg == "--tail")
+            settings.tailSeconds = value.getDoubleValue();
+        else if (arg == "--state")
+            settings.stateFile = File::getCurrentWorkingDirectory().getChildFile(value);
+        else if (arg == "--set" && value.containsChar('='))
+            settings.parameterValues.set(value.upToFirstOccurrenceOf("=", false, false),
+                                         value.fromFirstOccurrenceOf("=", false, false));
+        else if (arg == "--batch")
+            manifest = File::getCurrentWorkingDirectory().getChildFile(value);
+        else if (arg == "--threads")
+            numThreads = value.getIntValue();
+        else
+        {
+            std::cerr << "Unknown option " << arg << " " << value << std::endl;
+            return 1;
+        }
+    }
+
+    const auto isBatch = manifest != File();
+
+    if (files.size() != (isBatch ? 0 : 2) || settings.sampleRate <= 0.0 || settings.blockSize <= 0
+         || numThreads <= 0)
+    {
+        printUsage();
+        return 1;
+    }
+
+    if (isBatch)
+        return renderBatch(manifest, settings, numThreads);
+
+    const auto midiFile = File::getCurrentWorkingDirectory().getChildFile(files[0]);
+    const auto outputFile = File::getCurrentWorkingDirectory().getChildFile(files[1]);
+
+    OfflineRenderer::Stats stats;
+    const auto result = OfflineRenderer::render(midiFile, outputFile, settings, stats);
+
+    if (result.failed())
+    {
+        std::cerr << result.getErrorMessage() << std::endl;
+        return 1;
+    }
+
+    std::cout << "Rendered " << describe(stats) << std::endl;
+
+    return 0;
+}
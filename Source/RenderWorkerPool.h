@@ -0,0 +1,172 @@
+#pragma once
+
+#include "AudioThreadChecker.h"
+
+// A fixed set of helper threads that share the work of one audio block with the audio thread.
+//
+// A job is split into numbered items. run() publishes the job and then claims items itself,
+// exactly like the workers do, so it never waits for a worker to wake up: if every worker is
+// asleep or busy, the audio thread simply renders all the items. The only wait is a short spin at
+// the end for items that a worker has already started. Nothing here allocates or takes a lock
+// once the threads are running.
+//
+// Which thread renders which item changes from block to block, so a job must write each item's
+// result to its own place and combine them afterwards in a fixed order to be deterministic.
+//
+// Idle workers spin, yielding now and then, so they pick up the next block without any wake-up
+// latency. Once nothing has been published for idleTimeoutMs (playback stopped), they fall back
+// to polling once a millisecond to give the cores back.
+struct RenderWorkerPool
+{
+    struct Job
+    {
+        virtual ~Job() {}
+        virtual void renderItem(int item) noexcept = 0;
+    };
+
+    static constexpr int idleTimeoutMs = 100;
+
+    ~RenderWorkerPool()
+    {
+        setNumWorkers(0);
+    }
+
+    // Starts or stops worker threads. This allocates and must not be called during run().
+    void setNumWorkers(int numWorkers)
+    {
+        numWorkers = jlimit(0, jmax(0, SystemStats::getNumCpus() - 1), numWorkers);
+
+        for (auto* worker : workers)
+            worker->signalThreadShouldExit();
+
+        for (auto* worker : workers)
+            worker->stopThread(1000);
+
+        workers.clear();
+
+        for (auto i = 0; i < numWorkers; ++i)
+        {
+            auto* worker = workers.add(new Worker(*this, i));
+            worker->startThread(Thread::realtimeAudioPriority);
+        }
+    }
+
+    int getNumWorkers() const noexcept
+    {
+        return workers.size();
+    }
+
+    // Renders items 0 to numItems - 1 of the job and returns once every one of them is done
+    void run(Job& job, int numItems) noexcept
+    {
+        if (workers.isEmpty() || numItems <= 1)
+        {
+            for (auto i = 0; i < numItems; ++i)
+                job.renderItem(i);
+
+            return;
+        }
+
+        currentJob.store(&job, std::memory_order_relaxed);
+        itemsDone.store(0, std::memory_order_relaxed);
+
+        // Publishing the ticket releases the job and the item count to whoever claims from it
+        ticket.store((uint64)numItems << 32, std::memory_order_release);
+
+        renderItems();
+
+        // A worker that got preempted part way through an item holds everything up, so give up
+        // the time slice every so often in case it is waiting for this core
+        for (auto spins = 1; itemsDone.load(std::memory_order_acquire) < numItems; ++spins)
+        {
+            pause();
+
+            if ((spins & 255) == 0)
+                Thread::yield();
+        }
+    }
+
+private:
+    // The ticket holds the number of items in its top 32 bits and the next unclaimed item in the
+    // bottom 32. Claiming is a single fetch_add, and because the count travels with the counter a
+    // worker that arrives late can never mistake an item of a finished job for one of a new job.
+    bool renderItems() noexcept
+    {
+       #if BASICSYNTH_CHECK_AUDIO_THREAD
+        // The workers render part of the audio thread's block, so they are held to the same rules
+        const AudioThreadChecker::ScopedAudioThread audioThread;
+       #endif
+
+        auto renderedAny = false;
+
+        for (;;)
+        {
+            const auto claimed = ticket.fetch_add(1, std::memory_order_acquire);
+            const auto item = (uint32)claimed;
+
+            if (item >= (uint32)(claimed >> 32))
+                return renderedAny;
+
+            // Safe to read: this job can't finish, nor a new one start, until the item is done
+            currentJob.load(std::memory_order_relaxed)->renderItem((int)item);
+            itemsDone.fetch_add(1, std::memory_order_release);
+
+            renderedAny = true;
+        }
+    }
+
+    bool hasUnclaimedItems() const noexcept
+    {
+        const auto current = ticket.load(std::memory_order_relaxed);
+        return (uint32)current < (uint32)(current >> 32);
+    }
+
+    static void pause() noexcept
+    {
+       #if JUCE_INTEL && JUCE_USE_SIMD
+        _mm_pause();
+       #endif
+    }
+
+    struct Worker : public Thread
+    {
+        Worker(RenderWorkerPool& p, int index) : Thread("Render worker " + String(index)), pool(p) {}
+
+        void run() override
+        {
+            // The workers render part of the audio thread's block, so they need the same
+            // flush-to-zero mode as processBlock()
+            ScopedNoDenormals noDenormals;
+
+            auto lastWork = Time::getMillisecondCounter();
+
+            while (! threadShouldExit())
+            {
+                if (pool.hasUnclaimedItems() && pool.renderItems())
+                {
+                    lastWork = Time::getMillisecondCounter();
+                    continue;
+                }
+
+                if (Time::getMillisecondCounter() - lastWork > (uint32)idleTimeoutMs)
+                {
+                    wait(1);
+                    continue;
+                }
+
+                for (auto i = 0; i < 64; ++i)
+                    pause();
+
+                Thread::yield();
+            }
+        }
+
+        RenderWorkerPool& pool;
+    };
+
+    OwnedArray<Worker> workers;
+
+    std::atomic<Job*> currentJob { nullptr };
+    std::atomic<uint64> ticket { 0 };
+    std::atomic<int> itemsDone { 0 };
+};
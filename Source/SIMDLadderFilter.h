@@ -0,0 +1,239 @@
+#pragma once
+
+// The same filter as dsp::LadderFilter<float>, but with every channel in its own lane of a
+// dsp::SIMDRegister, so one pass through the ladder processes a whole frame: both channels of a
+// stereo signal, or up to numLanes channels (4 with SSE/NEON, 8 with AVX), for example several
+// stereo filters that share their settings.
+//
+// dsp::LadderFilter runs the five-stage ladder and its two saturationLUT lookups separately for
+// each channel. A table lookup would need a gather per lane, so here the saturation is Lambert's
+// 7/6 order rational approximation of tanh instead, on the same clamped [-5, 5] input range as
+// the table. It is within 1e-4 of tanh, while the 128 point table is only within about 6e-4, so
+// the difference between the two filters is mostly the table's error. With a full scale input the
+// outputs differ by less than 1e-3 (-60 dB) with no drive, and by at most 5e-3 (-46 dB) in the
+// worst case tried (all four modes, drive 10, resonance 1, cutoff 20 Hz to 20 kHz). The settings
+// and their smoothing are the same.
+//
+// Processing a frame is one long chain of dependent operations whatever the number of lanes, so
+// the gain comes from filling the register: 8 channels cost about the same as 1. For a single
+// stereo signal dsp::LadderFilter, which can overlap the work of its two channels, is faster.
+struct SIMDLadderFilter
+{
+    using Vector = dsp::SIMDRegister<float>;
+    using Mode = dsp::LadderFilter<float>::Mode;
+
+    static constexpr int numLanes = (int)Vector::SIMDNumElements;
+
+    SIMDLadderFilter()
+    {
+        stateStorage.calloc((size_t)(numStates * numLanes + numLanes));
+        state = Vector::getNextSIMDAlignedPtr(stateStorage.get());
+
+        setSampleRate(1000.0f);
+        setResonance(0.0f);
+        setDrive(1.2f);
+        setMode(Mode::LPF12);
+    }
+
+    void setEnabled(bool newValue) noexcept
+    {
+        enabled = newValue;
+    }
+
+    void setMode(Mode newValue) noexcept
+    {
+        switch (newValue)
+        {
+            case Mode::LPF12:   A = {{ 0.0f, 0.0f,  1.0f, 0.0f,  0.0f }}; comp = 0.5f;  break;
+            case Mode::HPF12:   A = {{ 1.0f, -2.0f, 1.0f, 0.0f,  0.0f }}; comp = 0.0f;  break;
+            case Mode::LPF24:   A = {{ 0.0f, 0.0f,  0.0f, 0.0f,  1.0f }}; comp = 0.5f;  break;
+            case Mode::HPF24:   A = {{ 1.0f, -4.0f, 6.0f, -4.0f, 1.0f }}; comp = 0.0f;  break;
+            default:            jassertfalse;                                           break;
+        }
+
+        for (auto& a : A)
+            a *= 1.2f;
+
+        reset();
+    }
+
+    // Up to numLanes channels can be processed
+    void prepare(const dsp::ProcessSpec& spec)
+    {
+        jassert(spec.numChannels <= (uint32)numLanes);
+
+        setSampleRate((float)spec.sampleRate);
+        numChannels = jmin((size_t)numLanes, (size_t)spec.numChannels);
+        reset();
+    }
+
+    size_t getNumChannels() const noexcept
+    {
+        return numChannels;
+    }
+
+    void reset() noexcept
+    {
+        FloatVectorOperations::clear(state, numStates * numLanes);
+
+        cutoffTransformSmoother.setValue(cutoffTransformSmoother.getTargetValue(), true);
+        scaledResonanceSmoother.setValue(scaledResonanceSmoother.getTargetValue(), true);
+    }
+
+    void setCutoffFrequencyHz(float newValue) noexcept
+    {
+        jassert(newValue > 0.0f);
+        cutoffFreqHz = newValue;
+        updateCutoffFreq();
+    }
+
+    void setResonance(float newValue) noexcept
+    {
+        jassert(newValue >= 0.0f && newValue <= 1.0f);
+        scaledResonanceSmoother.setValue(jmap(newValue, 0.1f, 1.0f));
+    }
+
+    void setDrive(float newValue) noexcept
+    {
+        jassert(newValue >= 1.0f);
+
+        drive = newValue;
+        gain = std::pow(drive, -2.642f) * 0.6103f + 0.3903f;
+        drive2 = drive * 0.04f + 0.96f;
+        gain2 = std::pow(drive2, -2.642f) * 0.6103f + 0.3903f;
+    }
+
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        const auto& inputBlock = context.getInputBlock();
+        auto& outputBlock = context.getOutputBlock();
+        const auto numBlockChannels = outputBlock.getNumChannels();
+        const auto numSamples = outputBlock.getNumSamples();
+
+        jassert(inputBlock.getNumChannels() <= getNumChannels());
+        jassert(inputBlock.getNumChannels() == numBlockChannels);
+        jassert(inputBlock.getNumSamples()  == numSamples);
+
+        if (! enabled || context.isBypassed)
+        {
+            outputBlock.copy(inputBlock);
+            return;
+        }
+
+        Vector s[numStates];
+
+        for (auto i = 0; i < numStates; ++i)
+            s[i] = Vector::fromRawArray(state + i * numLanes);
+
+        // Lanes without a channel are fed silence
+        alignas(sizeof(Vector)) float frame[numLanes] = {};
+
+        for (size_t n = 0; n < numSamples; ++n)
+        {
+            for (size_t ch = 0; ch < numBlockChannels; ++ch)
+                frame[ch] = inputBlock.getChannelPointer(ch)[n];
+
+            processFrame(Vector::fromRawArray(frame), s).copyToRawArray(frame);
+
+            for (size_t ch = 0; ch < numBlockChannels; ++ch)
+                outputBlock.getChannelPointer(ch)[n] = frame[ch];
+        }
+
+        for (auto i = 0; i < numStates; ++i)
+            s[i].copyToRawArray(state + i * numLanes);
+    }
+
+private:
+    static constexpr int numStates = 5;
+
+    // The same maths as LadderFilter::processSample(), with the coefficients broadcast to every
+    // lane
+    Vector processFrame(Vector input, Vector* s) noexcept
+    {
+        const auto a1 = cutoffTransformSmoother.getNextValue();
+        const auto resonanceScale = scaledResonanceSmoother.getNextValue() * -4.0f;
+
+        const auto g  = a1 * -1.0f + 1.0f;
+        const auto b0 = g * 0.76923076923f;
+        const auto b1 = g * 0.23076923076f;
+
+        const auto dx = saturate(input * drive) * gain;
+        const auto a  = dx + (saturate(s[4] * drive2) * gain2 - dx * comp) * resonanceScale;
+
+        const auto b = s[0] * b1 + s[1] * a1 + a * b0;
+        const auto c = s[1] * b1 + s[2] * a1 + b * b0;
+        const auto d = s[2] * b1 + s[3] * a1 + c * b0;
+        const auto e = s[3] * b1 + s[4] * a1 + d * b0;
+
+        s[0] = a;
+        s[1] = b;
+        s[2] = c;
+        s[3] = d;
+        s[4] = e;
+
+        return a * A[0] + b * A[1] + c * A[2] + d * A[3] + e * A[4];
+    }
+
+    // tanh(x) for x clamped to [-5, 5]
+    static Vector saturate(Vector x) noexcept
+    {
+        x = Vector::min(Vector::max(x, Vector::expand(-5.0f)), Vector::expand(5.0f));
+
+        const auto x2 = x * x;
+        const auto p = x * (((x2 + 378.0f) * x2 + 17325.0f) * x2 + 135135.0f);
+        const auto q = ((x2 * 28.0f + 3150.0f) * x2 + 62370.0f) * x2 + 135135.0f;
+
+        return divide(p, q);
+    }
+
+    // SIMDRegister has no division operator
+    static Vector divide(Vector numerator, Vector denominator) noexcept
+    {
+       #if JUCE_INTEL && defined(__AVX2__)
+        return { _mm256_div_ps(numerator.value, denominator.value) };
+       #elif JUCE_INTEL
+        return { _mm_div_ps(numerator.value, denominator.value) };
+       #else
+        alignas(sizeof(Vector)) float n[numLanes], d[numLanes];
+
+        numerator.copyToRawArray(n);
+        denominator.copyToRawArray(d);
+
+        for (auto i = 0; i < numLanes; ++i)
+            n[i] /= d[i];
+
+        return Vector::fromRawArray(n);
+       #endif
+    }
+
+    void setSampleRate(float newValue) noexcept
+    {
+        jassert(newValue > 0.0f);
+        cutoffFreqScaler = -MathConstants<float>::twoPi / newValue;
+
+        cutoffTransformSmoother.reset(newValue, 0.05);
+        scaledResonanceSmoother.reset(newValue, 0.05);
+
+        updateCutoffFreq();
+    }
+
+    void updateCutoffFreq() noexcept
+    {
+        cutoffTransformSmoother.setValue(std::exp(cutoffFreqHz * cutoffFreqScaler));
+    }
+
+    // The ladder state, one Vector per stage. Kept on the heap so it is aligned for SIMD loads
+    // even when the filter itself isn't.
+    HeapBlock<float> stateStorage;
+    float* state = nullptr;
+
+    std::array<float, numStates> A;
+    float drive = 1.0f, drive2 = 1.0f, gain = 1.0f, gain2 = 1.0f, comp = 0.0f;
+    float cutoffFreqHz = 200.0f, cutoffFreqScaler = 0.0f;
+
+    LinearSmoothedValue<float> cutoffTransformSmoother, scaledResonanceSmoother;
+
+    size_t numChannels = 2;
+    bool enabled = true;
+};
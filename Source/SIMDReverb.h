@@ -0,0 +1,414 @@
+#pragma once
+
+// The same Freeverb algorithm as juce::Reverb (and so dsp::Reverb), with the same Parameters,
+// but with the comb filters advanced together in the lanes of a dsp::SIMDRegister.
+//
+// juce::Reverb runs each of its 16 comb filters (8 per channel) and 8 allpass filters as a
+// separate scalar filter, one sample at a time, and every one of them wraps its ring buffer with
+// an integer modulo. Here the work is done in sub-blocks that are never longer than the shortest
+// delay, which means every value a filter reads within a sub-block was written before the
+// sub-block started:
+//
+//  - Comb filters. Each comb's delayed samples for the sub-block are copied into a staging area
+//    laid out frame by frame, lane = channel * numCombs + comb. The damping filter, which is the
+//    only part that depends on the previous sample, then runs down the frames with all the combs
+//    of a channel in the registers at once (one register with AVX, two with SSE/NEON), and the
+//    new values are copied back into the rings.
+//  - Allpass filters. With no feedback within a sub-block, each one is a plain loop over
+//    contiguous samples of its ring, which the compiler can vectorise across time.
+//
+// The smoothing of the parameters is the same, sample by sample. The outputs differ from
+// juce::Reverb's only by float rounding: the comb outputs are added in a different order, and
+// there is no JUCE_UNDENORMALISE, which adds and subtracts 0.1 to flush tiny values. Denormals are
+// turned off for the duration of each process call instead.
+struct SIMDReverb
+{
+    using Vector = dsp::SIMDRegister<float>;
+    using Parameters = Reverb::Parameters;
+
+    static constexpr int numLanes = (int)Vector::SIMDNumElements;
+    static constexpr int numCombs = 8;
+    static constexpr int numAllPasses = 4;
+    static constexpr int numChannels = 2;
+    static constexpr int numCombLanes = numCombs * numChannels;
+    static constexpr int groupsPerChannel = numCombs / numLanes;
+    static constexpr int maxSubBlockSize = 64;
+
+    static_assert(numCombs % numLanes == 0, "Each register must hold the combs of only one channel");
+
+    SIMDReverb()
+    {
+        workStorage.calloc((size_t)(numWorkValues + numLanes));
+        auto* work = Vector::getNextSIMDAlignedPtr(workStorage.get());
+
+        staged         = work;
+        combLast       = staged + maxSubBlockSize * numCombLanes;
+        combInput      = combLast + numCombLanes;
+        dampValues     = combInput + maxSubBlockSize;
+        feedbackValues = dampValues + maxSubBlockSize;
+        wet[0]         = feedbackValues + maxSubBlockSize;
+        wet[1]         = wet[0] + maxSubBlockSize;
+
+        setParameters(Parameters());
+        setSampleRate(44100.0);
+    }
+
+    //==============================================================================
+    const Parameters& getParameters() const noexcept
+    {
+        return parameters;
+    }
+
+    // The same scaling as Reverb::setParameters()
+    void setParameters(const Parameters& newParams)
+    {
+        const auto wetScaleFactor = 3.0f;
+        const auto dryScaleFactor = 2.0f;
+
+        const auto wetLevel = newParams.wetLevel * wetScaleFactor;
+        dryGain.setValue(newParams.dryLevel * dryScaleFactor);
+        wetGain1.setValue(0.5f * wetLevel * (1.0f + newParams.width));
+        wetGain2.setValue(0.5f * wetLevel * (1.0f - newParams.width));
+
+        gain = isFrozen(newParams.freezeMode) ? 0.0f : 0.015f;
+        parameters = newParams;
+        updateDamping();
+    }
+
+    // Allocates the delay lines, so call this before processing rather than from it
+    void setSampleRate(double sampleRate)
+    {
+        jassert(sampleRate > 0);
+
+        static const short combTunings[] = { 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 }; // (at 44100Hz)
+        static const short allPassTunings[] = { 556, 441, 341, 225 };
+        const auto stereoSpread = 23;
+        const auto intSampleRate = (int)sampleRate;
+
+        auto totalSize = 0;
+        subBlockSize = maxSubBlockSize;
+
+        auto setSize = [&](DelayLine& line, int tuning)
+        {
+            line.size = jmax(1, (intSampleRate * tuning) / 44100);
+            line.start = totalSize;
+            totalSize += line.size;
+            subBlockSize = jmin(subBlockSize, line.size);
+        };
+
+        for (auto ch = 0; ch < numChannels; ++ch)
+        {
+            for (auto i = 0; i < numCombs; ++i)
+                setSize(combs[ch * numCombs + i], combTunings[i] + ch * stereoSpread);
+
+            for (auto i = 0; i < numAllPasses; ++i)
+                setSize(allPasses[ch][i], allPassTunings[i] + ch * stereoSpread);
+        }
+
+        // All of the delay lines share one block of memory
+        delayStorage.malloc((size_t)totalSize);
+        delayStorageSize = totalSize;
+
+        const auto smoothTime = 0.01;
+        damping .reset(sampleRate, smoothTime);
+        feedback.reset(sampleRate, smoothTime);
+        dryGain .reset(sampleRate, smoothTime);
+        wetGain1.reset(sampleRate, smoothTime);
+        wetGain2.reset(sampleRate, smoothTime);
+
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        FloatVectorOperations::clear(delayStorage.get(), delayStorageSize);
+        FloatVectorOperations::clear(combLast, numCombLanes);
+
+        for (auto& comb : combs)
+            comb.index = 0;
+
+        for (auto& channel : allPasses)
+            for (auto& allPass : channel)
+                allPass.index = 0;
+    }
+
+    // How long the longest comb filter takes to die away by 60 dB once the input stops, plus the
+    // delay through the allpass filters. Infinite while frozen.
+    double getTailLengthSeconds() const noexcept
+    {
+        const auto feedbackGain = (double)feedback.getTargetValue();
+
+        if (feedbackGain >= 1.0)
+            return std::numeric_limits<double>::infinity();
+
+        // The right channel's filters are the longer ones (see setSampleRate())
+        const auto longestComb = (1617 + 23) / 44100.0;
+        const auto allPassDelay = (556 + 441 + 341 + 225 + 4 * 23) / 44100.0;
+
+        return longestComb * -3.0 / std::log10(feedbackGain) + allPassDelay;
+    }
+
+    void processStereo(float* left, float* right, int numSamples) noexcept
+    {
+        jassert(left != nullptr && right != nullptr);
+        process(left, right, numSamples);
+    }
+
+    void processMono(float* samples, int numSamples) noexcept
+    {
+        jassert(samples != nullptr);
+        process(samples, nullptr, numSamples);
+    }
+
+    //==============================================================================
+    // The same interface as dsp::Reverb, so this can be swapped in for it
+    bool isEnabled() const noexcept
+    {
+        return enabled;
+    }
+
+    void setEnabled(bool newValue) noexcept
+    {
+        enabled = newValue;
+    }
+
+    void prepare(const dsp::ProcessSpec& spec)
+    {
+        setSampleRate(spec.sampleRate);
+    }
+
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        const auto& inputBlock = context.getInputBlock();
+        auto& outputBlock = context.getOutputBlock();
+        const auto numInChannels = inputBlock.getNumChannels();
+        const auto numOutChannels = outputBlock.getNumChannels();
+        const auto numSamples = (int)outputBlock.getNumSamples();
+
+        jassert(inputBlock.getNumSamples() == (size_t)numSamples);
+
+        outputBlock.copy(inputBlock);
+
+        if (! enabled || context.isBypassed)
+            return;
+
+        if (numInChannels == 1 && numOutChannels == 1)
+            processMono(outputBlock.getChannelPointer(0), numSamples);
+        else if (numInChannels == 2 && numOutChannels == 2)
+            processStereo(outputBlock.getChannelPointer(0), outputBlock.getChannelPointer(1), numSamples);
+        else
+            jassertfalse; // invalid channel configuration
+    }
+
+private:
+    struct DelayLine
+    {
+        int start = 0, size = 0, index = 0;
+    };
+
+    static constexpr int numWorkValues = maxSubBlockSize * (numCombLanes + 5) + numCombLanes;
+
+    static bool isFrozen(float freezeMode) noexcept
+    {
+        return freezeMode >= 0.5f;
+    }
+
+    void updateDamping() noexcept
+    {
+        const auto roomScaleFactor = 0.28f;
+        const auto roomOffset = 0.7f;
+        const auto dampScaleFactor = 0.4f;
+
+        if (isFrozen(parameters.freezeMode))
+        {
+            damping.setValue(0.0f);
+            feedback.setValue(1.0f);
+        }
+        else
+        {
+            damping.setValue(parameters.damping * dampScaleFactor);
+            feedback.setValue(parameters.roomSize * roomScaleFactor + roomOffset);
+        }
+    }
+
+    // A null right channel means mono, which only uses the left channel's filters
+    void process(float* left, float* right, int numSamples) noexcept
+    {
+        ScopedNoDenormals noDenormals;
+
+        for (auto start = 0; start < numSamples; start += subBlockSize)
+            processSubBlock(left + start, right != nullptr ? right + start : nullptr,
+                            jmin(subBlockSize, numSamples - start));
+    }
+
+    void processSubBlock(float* left, float* right, int numSamples) noexcept
+    {
+        const auto numChannelsUsed = right != nullptr ? 2 : 1;
+        const auto numLanesUsed = numChannelsUsed * numCombs;
+
+        for (auto i = 0; i < numSamples; ++i)
+        {
+            combInput[i] = (right != nullptr ? left[i] + right[i] : left[i]) * gain;
+            dampValues[i] = damping.getNextValue();
+            feedbackValues[i] = feedback.getNextValue();
+        }
+
+        for (auto lane = 0; lane < numLanesUsed; ++lane)
+            readComb(lane, numSamples);
+
+        Vector last[numCombLanes / numLanes];
+
+        for (auto group = 0; group < numLanesUsed / numLanes; ++group)
+            last[group] = Vector::fromRawArray(combLast + group * numLanes);
+
+        for (auto i = 0; i < numSamples; ++i)
+        {
+            const auto input = combInput[i];
+            const auto damp = dampValues[i];
+            const auto undamped = 1.0f - damp;
+            const auto feedbackLevel = feedbackValues[i];
+
+            auto* frame = staged + i * numCombLanes;
+
+            for (auto ch = 0; ch < numChannelsUsed; ++ch)
+            {
+                auto sum = Vector::expand(0.0f);
+
+                for (auto group = ch * groupsPerChannel; group < (ch + 1) * groupsPerChannel; ++group)
+                {
+                    auto* lanes = frame + group * numLanes;
+                    const auto output = Vector::fromRawArray(lanes);
+
+                    last[group] = output * undamped + last[group] * damp;
+                    (last[group] * feedbackLevel + input).copyToRawArray(lanes);
+
+                    sum += output;
+                }
+
+                wet[ch][i] = sum.sum();
+            }
+        }
+
+        for (auto group = 0; group < numLanesUsed / numLanes; ++group)
+            last[group].copyToRawArray(combLast + group * numLanes);
+
+        for (auto lane = 0; lane < numLanesUsed; ++lane)
+            writeComb(lane, numSamples);
+
+        for (auto ch = 0; ch < numChannelsUsed; ++ch)
+            for (auto& allPass : allPasses[ch])
+                processAllPass(allPass, wet[ch], numSamples);
+
+        if (right == nullptr)
+        {
+            for (auto i = 0; i < numSamples; ++i)
+            {
+                const auto dry  = dryGain.getNextValue();
+                const auto wet1 = wetGain1.getNextValue();
+
+                left[i] = wet[0][i] * wet1 + left[i] * dry;
+            }
+
+            return;
+        }
+
+        for (auto i = 0; i < numSamples; ++i)
+        {
+            const auto dry  = dryGain.getNextValue();
+            const auto wet1 = wetGain1.getNextValue();
+            const auto wet2 = wetGain2.getNextValue();
+
+            const auto outL = wet[0][i], outR = wet[1][i];
+
+            left[i]  = outL * wet1 + outR * wet2 + left[i]  * dry;
+            right[i] = outR * wet1 + outL * wet2 + right[i] * dry;
+        }
+    }
+
+    // Copies the comb's next numSamples delayed values into its lane of the staging area
+    void readComb(int lane, int numSamples) noexcept
+    {
+        const auto& comb = combs[lane];
+        const auto* buffer = delayStorage.get() + comb.start;
+        const auto numBeforeWrap = jmin(numSamples, comb.size - comb.index);
+
+        for (auto i = 0; i < numBeforeWrap; ++i)
+            staged[i * numCombLanes + lane] = buffer[comb.index + i];
+
+        for (auto i = numBeforeWrap; i < numSamples; ++i)
+            staged[i * numCombLanes + lane] = buffer[i - numBeforeWrap];
+    }
+
+    // Stores the values left in the comb's lane back in the same places, and moves the comb on
+    void writeComb(int lane, int numSamples) noexcept
+    {
+        auto& comb = combs[lane];
+        auto* buffer = delayStorage.get() + comb.start;
+        const auto numBeforeWrap = jmin(numSamples, comb.size - comb.index);
+
+        for (auto i = 0; i < numBeforeWrap; ++i)
+            buffer[comb.index + i] = staged[i * numCombLanes + lane];
+
+        for (auto i = numBeforeWrap; i < numSamples; ++i)
+            buffer[i - numBeforeWrap] = staged[i * numCombLanes + lane];
+
+        comb.index = numBeforeWrap < numSamples ? numSamples - numBeforeWrap
+                                                : comb.index + numSamples;
+
+        if (comb.index == comb.size)
+            comb.index = 0;
+    }
+
+    // Runs the samples through the allpass in place, in runs that stop at the end of its ring
+    void processAllPass(DelayLine& allPass, float* samples, int numSamples) noexcept
+    {
+        auto* buffer = delayStorage.get() + allPass.start;
+
+        while (numSamples > 0)
+        {
+            const auto numThisTime = jmin(numSamples, allPass.size - allPass.index);
+            auto* delayed = buffer + allPass.index;
+
+            for (auto i = 0; i < numThisTime; ++i)
+            {
+                const auto bufferedValue = delayed[i];
+                const auto input = samples[i];
+
+                delayed[i] = input + bufferedValue * 0.5f;
+                samples[i] = bufferedValue - input;
+            }
+
+            allPass.index += numThisTime;
+
+            if (allPass.index == allPass.size)
+                allPass.index = 0;
+
+            samples += numThisTime;
+            numSamples -= numThisTime;
+        }
+    }
+
+    Parameters parameters;
+    float gain = 0.015f;
+
+    DelayLine combs[numCombLanes];
+    DelayLine allPasses[numChannels][numAllPasses];
+    HeapBlock<float> delayStorage;
+    int delayStorageSize = 0;
+    int subBlockSize = maxSubBlockSize;
+
+    // The staging frames, the combs' damping filter states and the per-sample values of one
+    // sub-block. Kept on the heap so they are aligned for SIMD loads even when the reverb isn't.
+    HeapBlock<float> workStorage;
+    float* staged = nullptr;
+    float* combLast = nullptr;
+    float* combInput = nullptr;
+    float* dampValues = nullptr;
+    float* feedbackValues = nullptr;
+    float* wet[numChannels] = {};
+
+    LinearSmoothedValue<float> damping, feedback, dryGain, wetGain1, wetGain2;
+
+    bool enabled = true;
+};
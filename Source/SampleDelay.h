@@ -0,0 +1,57 @@
+#pragma once
+
+// Delays every channel by a fixed whole number of samples. BasicSynth uses it to keep its latency
+// the same while the QualityGovernor has the filter running without its oversampling, which would
+// otherwise have delayed the signal, see BasicSynth::processEffects().
+struct SampleDelay
+{
+    // Allocates the delay line, so call this before processing rather than from it
+    void prepare(int numChannels, int newDelaySamples)
+    {
+        delaySamples = jmax(0, newDelaySamples);
+        line.setSize(jmax(1, numChannels), jmax(1, delaySamples));
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        line.clear();
+        position = 0;
+    }
+
+    int getDelaySamples() const noexcept
+    {
+        return delaySamples;
+    }
+
+    void process(dsp::AudioBlock<float> block) noexcept
+    {
+        if (delaySamples == 0)
+            return;
+
+        const auto numSamples = (int)block.getNumSamples();
+        const auto numChannels = jmin((int)block.getNumChannels(), line.getNumChannels());
+
+        for (auto ch = 0; ch < numChannels; ++ch)
+        {
+            auto* samples = block.getChannelPointer((size_t)ch);
+            auto* delayed = line.getWritePointer(ch);
+            auto p = position;
+
+            // The slot at the read position was written delaySamples ago, and takes the new sample
+            for (auto i = 0; i < numSamples; ++i)
+            {
+                std::swap(samples[i], delayed[p]);
+
+                if (++p == delaySamples)
+                    p = 0;
+            }
+        }
+
+        position = (position + numSamples) % delaySamples;
+    }
+
+private:
+    AudioBuffer<float> line;
+    int delaySamples = 0, position = 0;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+// Decides when the plugin has gone quiet for long enough to stop running its effects.
+//
+// The filter and reverb are skipped once the synth has stopped playing and the output of the whole
+// chain has stayed below the threshold for holdSeconds. Waiting on the output as well as the synth
+// lets the reverb ring out, and the hold time covers the gaps between its echoes, which are never
+// longer than the longest delay line (70 ms in the algorithmic reverbs). A convolution reverb
+// whose impulse response starts with a longer silence than that could be cut short.
+//
+// Nothing is reset on the way in or out of idle. The effects keep the state they had, which is
+// already below the threshold, so the next note carries on from it without a click.
+struct SilenceDetector
+{
+    // -100 dB
+    static constexpr float threshold = 1.0e-5f;
+    static constexpr double holdSeconds = 0.1;
+
+    void prepare(double sampleRate) noexcept
+    {
+        holdSamples = (int64)(sampleRate * holdSeconds);
+        reset();
+    }
+
+    // Makes the effects run again until the output has been quiet for the hold time
+    void reset() noexcept
+    {
+        quietSamples = 0;
+    }
+
+    bool isIdle() const noexcept
+    {
+        return quietSamples >= holdSamples;
+    }
+
+    // Call after each block the effects ran for, with whether both the synth and the effects'
+    // output were silent
+    void update(bool chainIsSilent, int numSamples) noexcept
+    {
+        if (chainIsSilent)
+            quietSamples += numSamples;
+        else
+            quietSamples = 0;
+    }
+
+    static bool isSilent(const dsp::AudioBlock<float>& block) noexcept
+    {
+        for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+        {
+            const auto range = FloatVectorOperations::findMinAndMax(block.getChannelPointer(ch),
+                                                                    (int)block.getNumSamples());
+
+            if (jmax(-range.getStart(), range.getEnd()) > threshold)
+                return false;
+        }
+
+        return true;
+    }
+
+private:
+    int64 quietSamples = 0, holdSamples = 0;
+};
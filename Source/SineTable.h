@@ -0,0 +1,95 @@
+#pragma once
+
+// A single cycle of a sine wave stored in a power-of-two sized table. Voices keep their phase in
+// a 32-bit fixed point accumulator that wraps around naturally at the end of each cycle. The top
+// bits of the phase pick the table entry and the remaining bits are used to interpolate linearly
+// to the next one, so no std::sin() or floating point wrapping is needed per sample.
+//
+// The table size trades memory for accuracy. Linear interpolation of a sine has a worst-case
+// error of roughly (2 * pi / size)^2 / 8, so each doubling of the table cuts the error by 12dB:
+//
+//      size      memory      max error
+//      256       1 KB        7.5e-5  (-82 dB)
+//      1024      4 KB        4.7e-6  (-106 dB)
+//      2048      8 KB        1.2e-6  (-118 dB)
+//      8192      32 KB       1.3e-7  (-138 dB, limited by float rounding)
+//
+// Only the largest tables get down to the least significant bit of a 24-bit output, 1.2e-7
+// (-138 dB). The default of 2048 points is 20 dB above that, though still 22 dB below a 16-bit
+// LSB, and a voice plays at no more than 0.15 of full scale, which takes its error down another
+// 16 dB. At 8 KB it leaves most of L1 for the rest of the synth; a 32 KB table would fill it.
+struct SineTable
+{
+    static constexpr int minSizeLog2     = 6;
+    static constexpr int maxSizeLog2     = 16;
+    static constexpr int defaultSizeLog2 = 11;
+
+    SineTable()
+    {
+        initialise(defaultSizeLog2);
+    }
+
+    // Rebuilds the table with 2^sizeLog2 points. This allocates, so it must not be called while
+    // any voice is reading from the table.
+    void initialise(int sizeLog2)
+    {
+        sizeLog2 = jlimit(minSizeLog2, maxSizeLog2, sizeLog2);
+
+        const auto size = 1 << sizeLog2;
+
+        // One extra guard point lets lookup() read index + 1 without wrapping
+        table.resize((size_t)size + 1);
+
+        for (auto i = 0; i <= size; ++i)
+            table[(size_t)i] = (float)std::sin(MathConstants<double>::twoPi * i / size);
+
+        indexShift = 32 - sizeLog2;
+        fractionMask = (1u << indexShift) - 1u;
+        fractionScale = 1.0f / (float)(1u << indexShift);
+    }
+
+    int getSize() const noexcept
+    {
+        return (int)table.size() - 1;
+    }
+
+    // Converts a frequency into the amount the phase accumulator advances each sample
+    static uint32 getPhaseIncrement(double cyclesPerSecond, double sampleRate) noexcept
+    {
+        return (uint32)std::llround(cyclesPerSecond / sampleRate * 4294967296.0);
+    }
+
+    float lookup(uint32 phase) const noexcept
+    {
+        const auto* point = table.data() + (phase >> indexShift);
+        const auto fraction = (float)(phase & fractionMask) * fractionScale;
+
+        return point[0] + fraction * (point[1] - point[0]);
+    }
+
+    // Measures the worst absolute error of lookup() against std::sin() over a full cycle. This is
+    // slow and only meant for choosing a table size.
+    double getMaxError() const
+    {
+        const uint32 numTestPoints = 1u << 20;
+        const auto step = (uint32)(4294967296.0 / numTestPoints);
+
+        double maxError = 0.0;
+
+        for (uint32 i = 0; i < numTestPoints; ++i)
+        {
+            const auto phase = i * step;
+            const auto exact = std::sin(MathConstants<double>::twoPi * phase / 4294967296.0);
+
+            maxError = jmax(maxError, std::abs(exact - (double)lookup(phase)));
+        }
+
+        return maxError;
+    }
+
+private:
+    std::vector<float> table;
+    int indexShift = 0;
+    uint32 fractionMask = 0;
+    float fractionScale = 0.0f;
+};
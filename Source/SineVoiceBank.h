@@ -0,0 +1,160 @@
+#pragma once
+
+// Oscillator and envelope state for every voice of the synth, stored as structure-of-arrays so
+// that dsp::SIMDRegister can advance a whole group of voices (4 with SSE/NEON, 8 with AVX) with
+// each instruction. Each SineWaveVoice owns one lane of the bank.
+//
+// A table lookup would need a gather per lane, so the bank evaluates the sine with a 9th order
+// polynomial instead. Phases are kept in [-0.5, 0.5) and the polynomial is evaluated on
+// 0.25 - |phase|, which is cos(2 * pi * phase) without any further range reduction. Starting
+// a note at a phase of -0.25 makes this a sine that starts from zero, like the per-voice path.
+// The worst-case error is about 1.7e-7 (-135 dB), comparable to an 8192 point SineTable.
+struct SineVoiceBank
+{
+    using Vector = dsp::SIMDRegister<float>;
+
+    static constexpr int numLanes = (int)Vector::SIMDNumElements;
+
+    // Allocates storage for numVoices lanes, rounded up to a whole number of SIMD groups
+    void prepare(int numVoices)
+    {
+        numGroups = jmax(1, (numVoices + numLanes - 1) / numLanes);
+
+        const auto size = (size_t)(numGroups * numLanes);
+
+        storage.calloc(size * numArrays + (size_t)numLanes);
+
+        auto* aligned = Vector::getNextSIMDAlignedPtr(storage.get());
+
+        phase     = aligned;
+        increment = aligned + size;
+        level     = aligned + size * 2;
+        envelope  = aligned + size * 3;
+        decay     = aligned + size * 4;
+    }
+
+    int getNumLanes() const noexcept
+    {
+        return numGroups * numLanes;
+    }
+
+    void startLane(int lane, float cyclesPerSample, float newLevel) noexcept
+    {
+        phase[lane]     = -0.25f;
+        increment[lane] = cyclesPerSample;
+        level[lane]     = newLevel;
+        envelope[lane]  = 1.0f;
+        decay[lane]     = 1.0f;
+    }
+
+    // Starts the exponential tail-off used by SineWaveVoice::stopNote()
+    void releaseLane(int lane) noexcept
+    {
+        decay[lane] = tailOffPerSample;
+    }
+
+    void stopLane(int lane) noexcept
+    {
+        level[lane]     = 0.0f;
+        envelope[lane]  = 0.0f;
+        increment[lane] = 0.0f;
+    }
+
+    // True once a lane has been stopped or its tail-off has decayed below the cut-off level
+    bool isLaneSilent(int lane) const noexcept
+    {
+        return level[lane] == 0.0f;
+    }
+
+    int getNumGroups() const noexcept
+    {
+        return numGroups;
+    }
+
+    // Renders the sum of all lanes into a mono buffer, overwriting its contents. Returns false if
+    // every lane was silent, in which case the buffer is left untouched.
+    bool render(float* output, int numSamples) noexcept
+    {
+        auto anyLaneActive = false;
+
+        for (auto group = 0; group < numGroups; ++group)
+        {
+            if (isGroupSilent(group))
+                continue;
+
+            if (! anyLaneActive)
+            {
+                FloatVectorOperations::clear(output, numSamples);
+                anyLaneActive = true;
+            }
+
+            renderGroup(group, output, numSamples);
+        }
+
+        return anyLaneActive;
+    }
+
+    bool isGroupSilent(int group) const noexcept
+    {
+        return Vector::fromRawArray(level + group * numLanes) == 0.0f;
+    }
+
+    // Adds one SIMD group of lanes to the output. Groups share no state, so different groups can
+    // be rendered on different threads at the same time.
+    void renderGroup(int group, float* output, int numSamples) noexcept
+    {
+        const auto cosineOffset   = Vector::expand(0.25f);
+        const auto halfCycle      = Vector::expand(0.5f);
+        const auto fullCycle      = Vector::expand(1.0f);
+        const auto twoPi          = Vector::expand(MathConstants<float>::twoPi);
+        const auto cutOffLevel    = Vector::expand(tailOffCutOff);
+        const auto c1 = Vector::expand( 0.99999998f);
+        const auto c3 = Vector::expand(-0.16666648f);
+        const auto c5 = Vector::expand( 0.0083328998f);
+        const auto c7 = Vector::expand(-0.00019800899f);
+        const auto c9 = Vector::expand( 2.5904896e-6f);
+
+        const auto offset = group * numLanes;
+
+        auto groupPhase     = Vector::fromRawArray(phase + offset);
+        auto groupIncrement = Vector::fromRawArray(increment + offset);
+        auto groupLevel     = Vector::fromRawArray(level + offset);
+        auto groupEnvelope  = Vector::fromRawArray(envelope + offset);
+        auto groupDecay     = Vector::fromRawArray(decay + offset);
+
+        for (auto i = 0; i < numSamples; ++i)
+        {
+            const auto x  = (cosineOffset - (groupPhase & absMask)) * twoPi;
+            const auto x2 = x * x;
+            const auto sine = x * (c1 + x2 * (c3 + x2 * (c5 + x2 * (c7 + x2 * c9))));
+
+            output[i] += (sine * groupLevel * groupEnvelope).sum();
+
+            groupEnvelope *= groupDecay;
+
+            // Zero both the level and the envelope of lanes that have finished, so the
+            // envelope can't keep decaying into denormals
+            const auto stillSounding = Vector::greaterThan(groupEnvelope, cutOffLevel);
+            groupLevel    = groupLevel & stillSounding;
+            groupEnvelope = groupEnvelope & stillSounding;
+
+            groupPhase += groupIncrement;
+            groupPhase -= fullCycle & Vector::greaterThanOrEqual(groupPhase, halfCycle);
+        }
+
+        groupPhase.copyToRawArray(phase + offset);
+        groupLevel.copyToRawArray(level + offset);
+        groupEnvelope.copyToRawArray(envelope + offset);
+    }
+
+    static constexpr float tailOffPerSample = 0.99f;
+    static constexpr float tailOffCutOff    = 0.005f;
+
+private:
+    static constexpr int numArrays = 5;
+    static constexpr uint32 absMask = 0x7fffffff;
+
+    HeapBlock<float> storage;
+    float *phase = nullptr, *increment = nullptr, *level = nullptr, *envelope = nullptr, *decay = nullptr;
+    int numGroups = 0;
+};
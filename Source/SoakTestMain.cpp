@@ -0,0 +1,568 @@
+// A command line tool that plays random MIDI through BasicSynth for as long as asked and fails if
+// processBlock() ever allocates or locks, see AudioThreadChecker.h. Built by the SoakTest target
+// of Builds/LinuxMakefile/Tools.mk, which builds everything with the checks in its own directories:
+//
+//   make -f Tools.mk AUDIO_THREAD_CHECKS=1 SoakTest
+//   BasicSynthSoakTest [--seconds <s>] [--seed <n>] [--flood-seconds <s>] [--allow <text>]... [--strict]
+//
+// Four shorter checks run first. The host MIDI check plays a single note-on at a range of sample
+// offsets into a block and fails unless the output is silent before the offset and sounding
+// after it. The convolution check runs the convolution reverb in non-realtime mode as fast as
+// it will go, the way an offline render does, and fails unless its output matches a direct
+// convolution, so no tail block was left out. The render check renders the same MIDI file twice
+// through OfflineRenderer with the convolution reverb on, and fails unless the two are the
+// same. The MIDI flood has several threads push events
+// into the synth's MidiEventQueue as fast as they can while the audio thread keeps playing, then
+// reports the slowest block against its budget. It fails if an event the queue accepted never
+// reached the synth.
+//
+// Each block gets a random size up to the prepared maximum, as some hosts do, and random MIDI:
+// notes of every length, sustain pedal, pitch wheel, all notes off, and now and then a burst
+// that goes past the polyphony. The parameters are automated in between blocks, the way a host
+// does, and the sample rate and block size are changed between sections of the run. The exit
+// code is 1 if anything was allocated or locked on the audio thread, other than at call sites
+// named by --allow.
+//
+// One lock is allowed by default: the synth's CriticalSection, which Synthesiser::processNextBlock()
+// takes for the whole block and its MIDI handlers take again. JUCE's Synthesiser has no way
+// around it. It is only ever held briefly by the message thread, when the polyphony or voice
+// bank is changed, and the nested locks are on a lock the audio thread already holds, so they
+// never wait. Locks by those functions are listed as allowed; allocations in them still fail
+// the run. --strict drops the default.
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "PluginProcessor.h"
+#include "AudioThreadChecker.h"
+#include "OfflineRenderer.h"
+#include "ProcessBlockBenchmark.h"
+
+#include <iostream>
+#include <thread>
+
+static void printUsage()
+{
+    std::cout << "Usage: BasicSynthSoakTest [options]" << std::endl
+              << std::endl
+              << "  --seconds <s>     audio to play, default 600" << std::endl
+              << "  --seed <n>        seed for the random MIDI, default 1" << std::endl
+              << "  --flood-seconds <s>  audio to play during the MIDI flood, default 10" << std::endl
+              << "  --allow <text>    ignores violations whose call stack contains the text, can be repeated" << std::endl
+              << "  --strict          doesn't allow the synth's own lock either" << std::endl;
+}
+
+// The functions that take the synth's lock on the audio thread, see above
+static StringArray getSynthLockers()
+{
+    return { "juce::Synthesiser::", "SineWaveSynth::" };
+}
+
+// Random MIDI and parameter changes, a block at a time
+struct SyntheticPlayer
+{
+    SyntheticPlayer(BasicSynth& s, int64 seed) : synth(s), random(seed)
+    {
+        for (auto* parameter : synth.getParameters())
+            parameters.add(parameter);
+    }
+
+    void fillNextBlock(MidiBuffer& midi, int numSamples)
+    {
+        midi.clear();
+
+        // About one event every 5 ms, and a burst of 64 notes now and then
+        const auto numEvents = random.nextInt(1000) == 0 ? 64 : random.nextInt(jmax(1, numSamples / 120) + 1);
+
+        for (auto i = 0; i < numEvents; ++i)
+            midi.addEvent(createEvent(), random.nextInt(numSamples));
+    }
+
+    void automateParameters()
+    {
+        if (random.nextInt(20) != 0)
+            return;
+
+        auto* parameter = parameters[random.nextInt(parameters.size())];
+        parameter->setValue(random.nextFloat());
+    }
+
+    MidiMessage createEvent()
+    {
+        const auto choice = random.nextInt(100);
+        const auto noteNumber = 24 + random.nextInt(72);
+
+        if (choice < 45)
+            return MidiMessage::noteOn(1, noteNumber, 0.2f + 0.8f * random.nextFloat());
+
+        if (choice < 90)
+            return MidiMessage::noteOff(1, noteNumber);
+
+        if (choice < 95)
+            return MidiMessage::controllerEvent(1, 64, random.nextBool() ? 127 : 0);
+
+        if (choice < 99)
+            return MidiMessage::pitchWheel(1, random.nextInt(16384));
+
+        return MidiMessage::allNotesOff(1);
+    }
+
+    BasicSynth& synth;
+    Random random;
+    Array<AudioProcessorParameter*> parameters;
+};
+
+// Plays one note-on from the host at each offset into a block, from a freshly prepared synth, and
+// returns how many offsets were wrong. The filter's oversampling can delay the note, but nothing
+// may come out before it.
+static int checkHostMidiOffsets(BasicSynth& synth)
+{
+    const auto sampleRate = 48000.0;
+    const auto blockSize = 1024;
+    const int offsets[] = { 0, 1, 63, 64, 500, 1000, blockSize - 1 };
+
+    AudioBuffer<float> buffer(2, blockSize);
+    MidiBuffer midi;
+    auto numFailures = 0;
+
+    for (auto offset : offsets)
+    {
+        synth.setPlayConfigDetails(0, 2, sampleRate, blockSize);
+        synth.prepareToPlay(sampleRate, blockSize);
+
+        midi.clear();
+        midi.addEvent(MidiMessage::noteOn(1, 69, 1.0f), offset);
+        synth.processBlock(buffer, midi);
+
+        // The note may only start at the end of this block, so look at the next one too
+        AudioBuffer<float> output(2, 2 * blockSize);
+        output.copyFrom(0, 0, buffer, 0, 0, blockSize);
+        output.copyFrom(1, 0, buffer, 1, 0, blockSize);
+
+        midi.clear();
+        synth.processBlock(buffer, midi);
+        output.copyFrom(0, blockSize, buffer, 0, 0, blockSize);
+        output.copyFrom(1, blockSize, buffer, 1, 0, blockSize);
+
+        const auto before = output.getMagnitude(0, offset);
+        const auto after = output.getMagnitude(offset, output.getNumSamples() - offset);
+        const auto isCorrect = before == 0.0f && after > 1.0e-3f;
+
+        if (! isCorrect)
+            ++numFailures;
+
+        std::cerr << "Host note-on at sample " << offset << ": peak " << before << " before, " << after
+                  << " after" << (isCorrect ? "" : ", wrong") << std::endl;
+    }
+
+    synth.releaseResources();
+    return numFailures;
+}
+
+// Runs a burst of noise through the convolution reverb in non-realtime mode, with nothing pacing
+// it, and returns the largest difference from a direct convolution with the same, normalised,
+// impulse response. Long impulse responses and short blocks give the tail thread the least time.
+static float checkUnpacedConvolution()
+{
+    const auto sampleRate = 48000.0;
+    const auto impulseLength = 50000;
+    const auto burstLength = 4096;
+    const auto numSamples = impulseLength + burstLength + 8192;
+    const int blockSizes[] = { 64, 512 };
+
+    Random random(1);
+    AudioBuffer<float> impulse(2, impulseLength), input(2, numSamples);
+    input.clear();
+
+    for (auto ch = 0; ch < 2; ++ch)
+    {
+        for (auto i = 0; i < impulseLength; ++i)
+            impulse.setSample(ch, i, (random.nextFloat() * 2.0f - 1.0f) * std::exp(-4.0f * (float)i / impulseLength));
+
+        for (auto i = 0; i < burstLength; ++i)
+            input.setSample(ch, i, random.nextFloat() * 2.0f - 1.0f);
+    }
+
+    // The reverb normalises the impulse response like this, see ConvolutionReverb::Engine
+    auto energy = 0.0;
+
+    for (auto ch = 0; ch < 2; ++ch)
+        for (auto i = 0; i < impulseLength; ++i)
+            energy += impulse.getSample(ch, i) * impulse.getSample(ch, i);
+
+    const auto gain = 0.125 / std::sqrt(energy / 2.0);
+
+    AudioBuffer<double> expected(2, numSamples);
+    expected.clear();
+
+    for (auto ch = 0; ch < 2; ++ch)
+    {
+        auto* dest = expected.getWritePointer(ch);
+        const auto* h = impulse.getReadPointer(ch);
+
+        for (auto i = 0; i < burstLength; ++i)
+        {
+            const auto x = input.getSample(ch, i) * gain;
+
+            for (auto j = 0; j < impulseLength; ++j)
+                dest[i + j] += x * h[j];
+        }
+    }
+
+    auto maxError = 0.0f;
+
+    for (auto blockSize : blockSizes)
+    {
+        ConvolutionReverb reverb;
+        reverb.loadImpulseResponse(impulse, sampleRate);
+        reverb.setNonRealtime(true);
+        reverb.setDryLevel(0.0f);
+        reverb.setWetLevel(0.5f);
+        reverb.prepare({ sampleRate, (uint32)blockSize, 2 });
+
+        AudioBuffer<float> output;
+        output.makeCopyOf(input);
+
+        for (auto start = 0; start < numSamples; start += blockSize)
+        {
+            dsp::AudioBlock<float> block(output.getArrayOfWritePointers(), 2, (size_t)start,
+                                         (size_t)jmin(blockSize, numSamples - start));
+            reverb.process(dsp::ProcessContextReplacing<float>(block));
+        }
+
+        auto error = 0.0f;
+
+        for (auto ch = 0; ch < 2; ++ch)
+            for (auto i = 0; i < numSamples; ++i)
+                error = jmax(error, std::abs(output.getSample(ch, i) - (float)expected.getSample(ch, i)));
+
+        std::cerr << "Unpaced convolution, blocks of " << blockSize << ": largest error " << error << ", "
+                  << reverb.getNumLateTailBlocks() << " tail blocks left out" << std::endl;
+
+        maxError = jmax(maxError, error);
+    }
+
+    return maxError;
+}
+
+// Renders a few seconds of chords with the convolution reverb twice, at each of two block sizes,
+// and returns the largest difference between the two renders. An offline render has to give the
+// same output every time, however far the tail thread falls behind.
+static float checkRepeatableRender()
+{
+    TemporaryFile impulseFile(".wav"), midiFile(".mid"), stateFile(".xml");
+
+    if (! ProcessBlockBenchmark::createImpulseResponse(impulseFile.getFile()))
+    {
+        std::cerr << "Couldn't write " << impulseFile.getFile().getFullPathName() << std::endl;
+        return 1.0f;
+    }
+
+    // Four chords at 120 bpm, a beat apart
+    MidiMessageSequence track;
+    const int notes[] = { 48, 55, 60, 64 };
+
+    for (auto chord = 0; chord < 4; ++chord)
+    {
+        for (auto note : notes)
+        {
+            track.addEvent(MidiMessage::noteOn(1, note + chord * 2, 0.8f), chord * 960.0);
+            track.addEvent(MidiMessage::noteOff(1, note + chord * 2), chord * 960.0 + 720.0);
+        }
+    }
+
+    track.updateMatchedPairs();
+
+    MidiFile midi;
+    midi.setTicksPerQuarterNote(960);
+    midi.addTrack(track);
+
+    {
+        FileOutputStream stream(midiFile.getFile());
+
+        if (stream.failedToOpen() || ! midi.writeTo(stream))
+        {
+            std::cerr << "Couldn't write " << midiFile.getFile().getFullPathName() << std::endl;
+            return 1.0f;
+        }
+    }
+
+    // The impulse response can only be given to the renderer in a saved state
+    {
+        BasicSynth synth;
+        synth.loadImpulseResponse(impulseFile.getFile());
+
+        ScopedPointer<XmlElement> xml(synth.parameters.copyState().createXml());
+
+        if (xml == nullptr || ! xml->writeToFile(stateFile.getFile(), {}))
+        {
+            std::cerr << "Couldn't write " << stateFile.getFile().getFullPathName() << std::endl;
+            return 1.0f;
+        }
+    }
+
+    OfflineRenderer::Settings settings;
+    settings.stateFile = stateFile.getFile();
+    settings.parameterValues.set(BasicSynth::REVERB_TYPE, "1");
+
+    const auto render = [&](AudioBuffer<float>& output)
+    {
+        OfflineRenderer::Stats stats;
+        output.setSize(2, 0);
+
+        const auto result = OfflineRenderer::render(midiFile.getFile(), settings, stats, [&](const AudioBuffer<float>& block)
+        {
+            const auto position = output.getNumSamples();
+            output.setSize(2, position + block.getNumSamples(), true);
+
+            for (auto ch = 0; ch < 2; ++ch)
+                output.copyFrom(ch, position, block, ch, 0, block.getNumSamples());
+
+            return true;
+        });
+
+        if (result.failed())
+            std::cerr << result.getErrorMessage() << std::endl;
+
+        return result.wasOk();
+    };
+
+    const int blockSizes[] = { 64, 512 };
+    auto maxDifference = 0.0f;
+
+    for (auto blockSize : blockSizes)
+    {
+        settings.blockSize = blockSize;
+
+        AudioBuffer<float> first, second;
+
+        if (! render(first) || ! render(second) || first.getNumSamples() != second.getNumSamples())
+            return 1.0f;
+
+        auto difference = 0.0f;
+
+        for (auto ch = 0; ch < 2; ++ch)
+            for (auto i = 0; i < first.getNumSamples(); ++i)
+                difference = jmax(difference, std::abs(first.getSample(ch, i) - second.getSample(ch, i)));
+
+        std::cerr << "Rendering twice, blocks of " << blockSize << ": largest difference " << difference << ", peak "
+                  << first.getMagnitude(0, first.getNumSamples()) << std::endl;
+
+        maxDifference = jmax(maxDifference, difference);
+    }
+
+    return maxDifference;
+}
+
+// Several threads flood the synth's MIDI queue while the audio thread plays. Returns false if
+// any event the queue accepted didn't come out of it.
+static bool runMidiFlood(BasicSynth& synth, double seconds)
+{
+    const auto sampleRate = 48000.0;
+    const auto blockSize = 256;
+    const auto numProducers = 4;
+
+    synth.setPlayConfigDetails(0, 2, sampleRate, blockSize);
+    synth.prepareToPlay(sampleRate, blockSize);
+
+    auto& source = synth.synthAudioSource;
+    const auto numDroppedBefore = source.midiQueue.getNumDroppedEvents();
+
+    std::atomic<bool> shouldStop { false };
+    std::atomic<int64> numAccepted { 0 };
+    OwnedArray<std::thread> producers;
+
+    for (auto i = 0; i < numProducers; ++i)
+    {
+        producers.add(new std::thread([&source, &shouldStop, &numAccepted, i]
+        {
+            Random random(i + 1);
+            int64 accepted = 0;
+
+            while (! shouldStop.load(std::memory_order_relaxed))
+            {
+                const auto noteNumber = 24 + random.nextInt(72);
+                const auto message = random.nextInt(8) == 0 ? MidiMessage::controllerEvent(1, 1, random.nextInt(128))
+                                   : random.nextBool()      ? MidiMessage::noteOn(1, noteNumber, 0.8f)
+                                                            : MidiMessage::noteOff(1, noteNumber);
+
+                // Once the ring is full, give the audio thread the core back, in case there aren't
+                // enough to go round
+                if (source.midiQueue.push(message, Time::getMillisecondCounterHiRes() * 0.001))
+                    ++accepted;
+                else
+                    std::this_thread::yield();
+            }
+
+            numAccepted.fetch_add(accepted);
+        }));
+    }
+
+    AudioBuffer<float> buffer(2, blockSize);
+    MidiBuffer midi;
+    int64 numBlocks = 0, numReceived = 0, totalNanoseconds = 0, worstNanoseconds = 0;
+    auto maxEventsInBlock = 0;
+
+    const auto playBlock = [&]
+    {
+        const auto startTime = StageTimings::now();
+        synth.processBlock(buffer, midi);
+        const auto nanoseconds = StageTimings::now() - startTime;
+
+        totalNanoseconds += nanoseconds;
+        worstNanoseconds = jmax(worstNanoseconds, nanoseconds);
+        numReceived += source.incomingMidi.getNumEvents();
+        maxEventsInBlock = jmax(maxEventsInBlock, source.incomingMidi.getNumEvents());
+        ++numBlocks;
+    };
+
+    for (auto samplesLeft = (int64)(seconds * sampleRate); samplesLeft > 0; samplesLeft -= blockSize)
+        playBlock();
+
+    shouldStop.store(true);
+
+    for (auto* producer : producers)
+        producer->join();
+
+    // Anything left in the ring comes out in the next block
+    playBlock();
+
+    synth.releaseResources();
+
+    const auto budgetNanoseconds = blockSize / sampleRate * 1.0e9;
+    const auto numDropped = source.midiQueue.getNumDroppedEvents() - numDroppedBefore;
+
+    std::cerr << "MIDI flood from " << numProducers << " threads: " << numAccepted.load() << " events queued, "
+              << numDropped << " dropped with the queue full, " << numReceived << " played, up to "
+              << maxEventsInBlock << " in a block" << std::endl
+              << "Blocks of " << blockSize << " at " << sampleRate << " Hz: mean "
+              << String(totalNanoseconds / (double)numBlocks / budgetNanoseconds * 100.0, 1) << "% of the budget, worst "
+              << String(worstNanoseconds / budgetNanoseconds * 100.0, 1) << "% (" << String(worstNanoseconds * 1.0e-3, 1)
+              << " us)" << std::endl;
+
+    return numReceived == numAccepted.load();
+}
+
+int main(int argc, char* argv[])
+{
+    ScopedJuceInitialiser_GUI juceInitialiser;
+
+    auto seconds = 600.0;
+    auto floodSeconds = 10.0;
+    int64 seed = 1;
+    StringArray allowed;
+    auto allowedLockers = getSynthLockers();
+
+    for (auto i = 1; i < argc; ++i)
+    {
+        const auto arg = String::fromUTF8(argv[i]);
+
+        if (arg == "--help" || arg == "-h")
+        {
+            printUsage();
+            return 0;
+        }
+
+        if (arg == "--strict")
+        {
+            allowedLockers.clear();
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+
+        const auto value = String::fromUTF8(argv[++i]);
+
+        if (arg == "--seconds")
+            seconds = value.getDoubleValue();
+        else if (arg == "--flood-seconds")
+            floodSeconds = value.getDoubleValue();
+        else if (arg == "--seed")
+            seed = value.getLargeIntValue();
+        else if (arg == "--allow")
+            allowed.add(value);
+        else
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+   #if ! BASICSYNTH_CHECK_AUDIO_THREAD
+    std::cerr << "This wasn't built with AUDIO_THREAD_CHECKS=1 (see Tools.mk), so nothing can be checked" << std::endl;
+    return 1;
+   #endif
+
+    AudioThreadChecker::initialise();
+
+    BasicSynth synth;
+    synth.synthAudioSource.setPolyphony(32);
+
+    const auto numOffsetFailures = checkHostMidiOffsets(synth);
+    const auto convolutionIsExact = checkUnpacedConvolution() < 1.0e-5f;
+    const auto renderIsRepeatable = checkRepeatableRender() == 0.0f;
+    const auto floodWasComplete = runMidiFlood(synth, floodSeconds);
+
+    if (! convolutionIsExact)
+        std::cerr << "Unpaced convolution: the output doesn't match a direct convolution" << std::endl;
+
+    if (! renderIsRepeatable)
+        std::cerr << "Repeated render: the two renders of the same file differ" << std::endl;
+
+    if (! floodWasComplete)
+        std::cerr << "MIDI flood: some queued events never reached the synth" << std::endl;
+
+    SyntheticPlayer player(synth, seed);
+
+    // Each section prepares the synth again with different settings
+    const double sampleRates[] = { 44100.0, 48000.0, 96000.0 };
+    const int blockSizes[] = { 64, 512, 1024, 128 };
+    const auto numSections = 12;
+    const auto secondsPerSection = seconds / numSections;
+
+    int64 numBlocks = 0;
+    const auto startTime = Time::getMillisecondCounterHiRes();
+
+    for (auto section = 0; section < numSections; ++section)
+    {
+        const auto sampleRate = sampleRates[section % numElementsInArray(sampleRates)];
+        const auto maximumBlockSize = blockSizes[section % numElementsInArray(blockSizes)];
+
+        synth.setPlayConfigDetails(0, 2, sampleRate, maximumBlockSize);
+        synth.prepareToPlay(sampleRate, maximumBlockSize);
+
+        AudioBuffer<float> buffer(2, maximumBlockSize);
+        MidiBuffer midi;
+        midi.ensureSize(4096);
+
+        for (auto samplesLeft = (int64)(secondsPerSection * sampleRate); samplesLeft > 0;)
+        {
+            const auto numSamples = (int)jmin(samplesLeft, (int64)(1 + player.random.nextInt(maximumBlockSize)));
+
+            player.automateParameters();
+            player.fillNextBlock(midi, numSamples);
+
+            AudioBuffer<float> block(buffer.getArrayOfWritePointers(), 2, numSamples);
+            synth.processBlock(block, midi);
+
+            samplesLeft -= numSamples;
+            ++numBlocks;
+        }
+
+        std::cerr << "Section " << section + 1 << " of " << numSections << ": " << sampleRate << " Hz, blocks up to "
+                  << maximumBlockSize << ", " << AudioThreadChecker::getNumViolations() << " violations so far" << std::endl;
+    }
+
+    synth.releaseResources();
+
+    std::cerr << "Played " << String(seconds, 1) << " s of audio in " << numBlocks << " blocks in "
+              << String((Time::getMillisecondCounterHiRes() - startTime) / 1000.0, 1) << " s" << std::endl;
+
+    const auto numViolations = AudioThreadChecker::printReport(std::cerr, allowed, allowedLockers);
+
+    std::cerr << numViolations << " audio thread violations, " << numOffsetFailures << " wrong host MIDI offsets" << std::endl;
+    return numViolations == 0 && numOffsetFailures == 0 && convolutionIsExact && renderIsRepeatable
+            && floodWasComplete ? 0 : 1;
+}
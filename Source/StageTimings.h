@@ -0,0 +1,159 @@
+#pragma once
+
+#include <chrono>
+
+// Measures how long each stage of processBlock() takes, for the CPU meter in the editor.
+//
+// The audio thread adds up the time spent in each stage over a block and then publishes running
+// totals in atomics, along with how much audio it has processed and the voice counts. Every atomic
+// has a single writer, so publishing is a few relaxed stores and never waits for the reader. The
+// editor takes a Snapshot on its timer and compares it with the previous one: the time a stage
+// took in between, divided by the length of the audio processed in between, is the share of the
+// real-time budget that stage used. The stages of one snapshot can be a block apart, which makes
+// no difference averaged over a timer interval.
+//
+// The voices are timed inside SineWaveSynth::renderVoices(), whose calls are interleaved with the
+// MIDI events of the block, so the MIDI stage is the rest of the synth's time: merging the MIDI
+// inputs, starting and stopping notes and the Synthesiser's own bookkeeping. With render threads,
+// the voice stage is the time the audio thread spends waiting for the block, not the CPU time of
+// every thread. A stage that is skipped, like all the effects while the plugin is idle, takes no
+// time.
+struct StageTimings
+{
+    enum Stage
+    {
+        midi,
+        voices,
+        filter,
+        reverb,
+        gain,
+        numStages
+    };
+
+    static const char* getStageName(int stage) noexcept
+    {
+        static const char* const names[] = { "MIDI", "Voices", "Filter", "Reverb", "Gain" };
+        return isPositiveAndBelow(stage, (int)numStages) ? names[stage] : "";
+    }
+
+    static int64 now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Adds the time from its construction to its destruction to a stage. Does nothing without
+    // a StageTimings.
+    struct ScopedStage
+    {
+        ScopedStage(StageTimings* t, Stage s) noexcept : timings(t), stage(s), startTime(t != nullptr ? now() : 0) {}
+
+        ~ScopedStage() noexcept
+        {
+            if (timings != nullptr)
+                timings->add(stage, now() - startTime);
+        }
+
+    private:
+        StageTimings* const timings;
+        const Stage stage;
+        const int64 startTime;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedStage)
+    };
+
+    // The rest are for the audio thread
+
+    void prepare(double newSampleRate) noexcept
+    {
+        sampleRate = newSampleRate;
+
+        for (auto& nanoseconds : blockNanoseconds)
+            nanoseconds = 0;
+    }
+
+    void add(Stage stage, int64 nanoseconds) noexcept
+    {
+        blockNanoseconds[stage] += nanoseconds;
+    }
+
+    // The time added to a stage so far in this block
+    int64 getBlockTime(Stage stage) const noexcept
+    {
+        return blockNanoseconds[stage];
+    }
+
+    // Publishes the block's times and starts on the next block
+    void finishBlock(int numSamples, int numActiveVoices, int64 numVoiceSteals) noexcept
+    {
+        for (auto stage = 0; stage < numStages; ++stage)
+        {
+            totals.nanoseconds[stage].store(totals.nanoseconds[stage].load(std::memory_order_relaxed) + blockNanoseconds[stage],
+                                            std::memory_order_relaxed);
+            blockNanoseconds[stage] = 0;
+        }
+
+        if (sampleRate > 0.0)
+            audioNanoseconds += (double)numSamples * 1.0e9 / sampleRate;
+
+        totals.audioNanoseconds.store((int64)audioNanoseconds, std::memory_order_relaxed);
+        totals.numActiveVoices.store(numActiveVoices, std::memory_order_relaxed);
+        totals.numVoiceSteals.store(numVoiceSteals, std::memory_order_relaxed);
+    }
+
+    // The rest can be called from any thread
+
+    struct Snapshot
+    {
+        int64 nanoseconds[numStages] = {};
+        int64 audioNanoseconds = 0;
+        int numActiveVoices = 0;
+        int64 numVoiceSteals = 0;
+
+        // The share of the real-time budget a stage used since an earlier snapshot
+        float getLoad(const Snapshot& earlier, int stage) const noexcept
+        {
+            const auto audioTime = audioNanoseconds - earlier.audioNanoseconds;
+
+            if (audioTime <= 0)
+                return 0.0f;
+
+            return (float)(nanoseconds[stage] - earlier.nanoseconds[stage]) / (float)audioTime;
+        }
+    };
+
+    Snapshot getSnapshot() const noexcept
+    {
+        Snapshot snapshot;
+
+        for (auto stage = 0; stage < numStages; ++stage)
+            snapshot.nanoseconds[stage] = totals.nanoseconds[stage].load(std::memory_order_relaxed);
+
+        snapshot.audioNanoseconds = totals.audioNanoseconds.load(std::memory_order_relaxed);
+        snapshot.numActiveVoices = totals.numActiveVoices.load(std::memory_order_relaxed);
+        snapshot.numVoiceSteals = totals.numVoiceSteals.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+private:
+    // Only touched by the audio thread
+    int64 blockNanoseconds[numStages] = {};
+    double audioNanoseconds = 0.0;
+    double sampleRate = 0.0;
+
+    // Written by the audio thread, read by anyone
+    struct Totals
+    {
+        std::atomic<int64> nanoseconds[numStages];
+        std::atomic<int64> audioNanoseconds { 0 };
+        std::atomic<int> numActiveVoices { 0 };
+        std::atomic<int64> numVoiceSteals { 0 };
+
+        Totals()
+        {
+            for (auto& value : nanoseconds)
+                value.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    Totals totals;
+};
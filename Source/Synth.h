@@ -1,5 +1,13 @@
 #pragma once
 
+#include "SineTable.h"
+#include "SineVoiceBank.h"
+#include "VoicePool.h"
+#include "RenderWorkerPool.h"
+#include "MidiEventQueue.h"
+#include "StageTimings.h"
+#include "TraceRecorder.h"
+
 struct SineWaveSound   : public SynthesiserSound
 {
     SineWaveSound() {}
@@ -10,7 +18,7 @@ struct SineWaveSound   : public SynthesiserSound
 
 struct SineWaveVoice   : public SynthesiserVoice
 {
-    SineWaveVoice() {}
+    SineWaveVoice(const SineTable& table, int voiceIndex) : sineTable(table), index(voiceIndex) {}
 
     bool canPlaySound(SynthesiserSound* sound) override
     {
@@ -20,88 +28,585 @@ struct SineWaveVoice   : public SynthesiserVoice
     void startNote(int midiNoteNumber, float velocity,
                     SynthesiserSound*, int /*currentPitchWheelPosition*/) override
     {
-        currentAngle = 0.0;
-        level = velocity * 0.15;
-        tailOff = 0.0;
+        currentPhase = 0;
+        level = velocity * 0.15f;
+        tailOff = 0.0f;
 
         auto cyclesPerSecond = MidiMessage::getMidiNoteInHertz(midiNoteNumber);
-        auto cyclesPerSample = cyclesPerSecond / getSampleRate();
 
-        angleDelta = cyclesPerSample * 2.0 * MathConstants<double>::pi;
+        if (bank != nullptr)
+            bank->startLane(index, (float)(cyclesPerSecond / getSampleRate()), level);
+        else
+            phaseDelta = SineTable::getPhaseIncrement(cyclesPerSecond, getSampleRate());
     }
 
     void stopNote(float /*velocity*/, bool allowTailOff) override
     {
         if (1 && allowTailOff)
         {
-            if (tailOff == 0.0)
-                tailOff = 1.0;
+            if (tailOff == 0.0f)
+            {
+                tailOff = 1.0f;
+
+                if (bank != nullptr)
+                    bank->releaseLane(index);
+
+                if (pool != nullptr)
+                    pool->noteReleased(index);
+            }
         }
         else
         {
-            clearCurrentNote();
-            angleDelta = 0.0;
+            endNote();
         }
     }
 
     void pitchWheelMoved(int) override      {}
     void controllerMoved(int, int) override {}
 
-    void renderNextBlock(AudioSampleBuffer& outputBuffer, int startSample, int numSamples) override
+    // Hands the oscillator and envelope of this voice over to its lane of a SineVoiceBank, or back
+    // to the per-voice render path when newBank is null. Must not be called while a note plays.
+    void setVoiceBank(SineVoiceBank* newBank) noexcept
+    {
+        jassert(! isVoiceActive());
+
+        bank = newBank;
+    }
+
+    // Lets the voice tell the pool when it starts tailing off and when it becomes free
+    void setVoicePool(VoicePool* newPool) noexcept
+    {
+        pool = newPool;
+    }
+
+    // Called by SineWaveSynth after the bank has rendered, to free the voice once its lane has
+    // finished tailing off
+    void finishNoteIfSilent()
+    {
+        if (bank != nullptr && isVoiceActive() && bank->isLaneSilent(index))
+            endNote();
+    }
+
+    // Allocates the scratch buffer the voice renders into. Blocks longer than this are rendered
+    // in several chunks.
+    void prepare(int maximumBlockSize)
+    {
+        scratch.setSize(1, jmax(1, maximumBlockSize));
+    }
+
+    int getMaximumBlockSize() const noexcept
+    {
+        return scratch.getNumSamples();
+    }
+
+    // The note's level before any tail-off, which is what it was started at
+    float getLevel() const noexcept
     {
-        if (angleDelta != 0.0)
+        return level;
+    }
+
+    // Renders up to getMaximumBlockSize() samples of this voice into its mono scratch buffer and
+    // returns it. If the note finishes part way through, the rest of the block is zeroed.
+    const float* renderVoiceBlock(int numSamples)
+    {
+        jassert(numSamples <= scratch.getNumSamples());
+
+        auto* out = scratch.getWritePointer(0);
+        auto i = 0;
+
+        if (tailOff > 0.0f)
         {
-            if (tailOff > 0.0)
+            while (i < numSamples)
             {
-                while(--numSamples >= 0)
+                out[i++] = sineTable.lookup(currentPhase) * level * tailOff;
+
+                currentPhase += phaseDelta;
+
+                tailOff *= 0.99f;
+
+                if (tailOff <= 0.005f)
                 {
-                    auto currentSample =(float)(std::sin(currentAngle) * level * tailOff);
+                    endNote();
+                    break;
+                }
+            }
+        }
+        else
+        {
+            for (; i < numSamples; ++i)
+            {
+                out[i] = sineTable.lookup(currentPhase) * level;
 
-                    for (auto i = outputBuffer.getNumChannels(); --i >= 0;)
-                        outputBuffer.addSample(i, startSample, currentSample);
+                currentPhase += phaseDelta;
+            }
+        }
 
-                    currentAngle += angleDelta;
-                    ++startSample;
+        if (i < numSamples)
+            FloatVectorOperations::clear(out + i, numSamples - i);
 
-                    tailOff *= 0.99;
+        return out;
+    }
 
-                    if (tailOff <= 0.005)
-                    {
-                        clearCurrentNote();
+    void renderNextBlock(AudioSampleBuffer& outputBuffer, int startSample, int numSamples) override
+    {
+        while (phaseDelta != 0 && numSamples > 0)
+        {
+            auto numThisTime = jmin(numSamples, getMaximumBlockSize());
+            auto* voiceSamples = renderVoiceBlock(numThisTime);
 
-                        angleDelta = 0.0;
-                        break;
-                    }
-                }
+            for (auto i = outputBuffer.getNumChannels(); --i >= 0;)
+                FloatVectorOperations::add(outputBuffer.getWritePointer(i, startSample),
+                                           voiceSamples, numThisTime);
+
+            startSample += numThisTime;
+            numSamples  -= numThisTime;
+        }
+    }
+
+private:
+    void endNote()
+    {
+        clearCurrentNote();
+        phaseDelta = 0;
+
+        if (bank != nullptr)
+            bank->stopLane(index);
+
+        if (pool != nullptr)
+            pool->noteFinished(index);
+    }
+
+    const SineTable& sineTable;
+
+    // Position of this voice in the synth, which is also its lane in the bank and the pool
+    const int index;
+
+    // The phase wraps around at 2^32, which is exactly one cycle of the sine table
+    uint32 currentPhase = 0, phaseDelta = 0;
+    float level = 0.0f, tailOff = 0.0f;
+
+    AudioBuffer<float> scratch { 1, 512 };
+
+    SineVoiceBank* bank = nullptr;
+    VoicePool* pool = nullptr;
+};
+
+// Synthesiser that mixes its voices a block at a time.
+//
+// Voices come from a fixed pool of up to maxPolyphony. A VoicePool tracks which of them are free,
+// held or tailing off, so finding a voice for a note-on, the voice to steal when all are busy
+// (the oldest one tailing off, else the oldest held one) and the voice to stop on a note-off are
+// all O(1) instead of scanning every voice.
+//
+// By default all voices are rendered together by a SineVoiceBank, which advances a whole SIMD
+// register of voices per instruction and sums them into one mono buffer. With the bank disabled,
+// each active voice renders into its own scratch buffer, which is then copied into the output for
+// the first voice and added for the rest using FloatVectorOperations.
+//
+// With render threads enabled, the SIMD groups of the bank are shared out between a
+// RenderWorkerPool and the audio thread. Each group renders into its own sub-mix, and the
+// sub-mixes are then added up in group order, which is exactly the order the single-threaded path
+// adds the groups in, so the output is bit-identical whatever the number of threads.
+struct SineWaveSynth : public Synthesiser,
+                       private RenderWorkerPool::Job
+{
+    static constexpr int defaultPolyphony = 4;
+    static constexpr int maxPolyphony     = 256;
+
+    SineWaveSynth(const SineTable& table) : sineTable(table)
+    {
+        setPolyphony(defaultPolyphony);
+    }
+
+    // Replaces the voices with a new pool of the given size. This allocates and cuts any sounding
+    // notes, so call it from the message thread rather than while playing.
+    void setPolyphony(int numVoices)
+    {
+        numVoices = jlimit(1, maxPolyphony, numVoices);
+
+        const ScopedLock sl(lock);
+
+        allNotesOff(0, false);
+        clearVoices();
+
+        for (auto i = 0; i < numVoices; ++i)
+            addVoice(new SineWaveVoice(sineTable, i));
+
+        prepare(maximumBlockSize);
+    }
+
+    void prepare(int newMaximumBlockSize)
+    {
+        const ScopedLock sl(lock);
+
+        // Reallocating the bank and pool drops the state of every voice, so cut anything still
+        // sounding
+        allNotesOff(0, false);
+
+        maximumBlockSize = jmax(1, newMaximumBlockSize);
+        bankOutput.setSize(1, maximumBlockSize);
+        bank.prepare(voices.size());
+        pool.prepare(voices.size());
+
+        // Each sub-mix starts on its own cache line, so threads rendering neighbouring groups
+        // never write to the same line
+        subMixStride = (maximumBlockSize + floatsPerCacheLine - 1) & ~(floatsPerCacheLine - 1);
+        subMixStorage.calloc((size_t)(bank.getNumGroups() * subMixStride + floatsPerCacheLine));
+        subMixes = dsp::SIMDRegister<float>::getNextSIMDAlignedPtr(subMixStorage.get());
+
+        while ((reinterpret_cast<pointer_sized_int>(subMixes) & 63) != 0)
+            ++subMixes;
+        groupIsActive.calloc((size_t)bank.getNumGroups());
+
+        for (auto* v : voices)
+        {
+            auto* voice = static_cast<SineWaveVoice*>(v);
+
+            voice->prepare(maximumBlockSize);
+            voice->setVoiceBank(useVoiceBank ? &bank : nullptr);
+            voice->setVoicePool(&pool);
+        }
+    }
+
+    void noteOn(int midiChannel, int midiNoteNumber, float velocity) override
+    {
+        const ScopedLock sl(lock);
+        TraceRecorder::instant("Note on", "note", midiNoteNumber);
+
+        for (auto* sound : sounds)
+        {
+            if (! (sound->appliesToNote(midiNoteNumber) && sound->appliesToChannel(midiChannel)))
+                continue;
+
+            // If hitting a note that's still ringing, stop it first (it could be still playing
+            // because of the sustain or sostenuto pedal)
+            auto index = pool.getVoiceForNote(midiChannel, midiNoteNumber);
+
+            if (index >= 0)
+                stopVoice(voices.getUnchecked(index), 1.0f, true);
+
+            // At the quality governor's voice limit the new note takes over the quietest held
+            // one, see setVoiceLimit(). Otherwise the oldest voice is stolen as usual.
+            const auto isAtVoiceLimit = isVoiceLimited() && pool.getNumHeldVoices() >= getVoiceLimit();
+
+            index = isAtVoiceLimit ? -1 : pool.getFreeVoice();
+
+            if (index < 0 && isNoteStealingEnabled())
+            {
+                index = isAtVoiceLimit ? getQuietestHeldVoice() : pool.getVoiceToSteal();
+                numVoiceSteals += index >= 0 ? 1 : 0;
+                TraceRecorder::instant("Voice stolen", "voice", index);
+            }
+
+            if (index >= 0)
+            {
+                startVoice(voices.getUnchecked(index), sound, midiChannel, midiNoteNumber, velocity);
+                pool.noteStarted(index, midiChannel, midiNoteNumber);
+            }
+        }
+    }
+
+    void noteOff(int midiChannel, int midiNoteNumber, float velocity, bool allowTailOff) override
+    {
+        const ScopedLock sl(lock);
+        TraceRecorder::instant("Note off", "note", midiNoteNumber);
+
+        const auto index = pool.getVoiceForNote(midiChannel, midiNoteNumber);
+
+        if (index < 0)
+            return;
+
+        auto* voice = voices.getUnchecked(index);
+
+        if (auto sound = voice->getCurrentlyPlayingSound())
+        {
+            if (sound->appliesToNote(midiNoteNumber) && sound->appliesToChannel(midiChannel))
+            {
+                voice->setKeyDown(false);
+
+                if (! (voice->isSustainPedalDown() || voice->isSostenutoPedalDown()))
+                    stopVoice(voice, velocity, allowTailOff);
+            }
+        }
+    }
+
+    // Switches between the SIMD voice bank and per-voice rendering. Any sounding notes are cut.
+    void setVoiceBankEnabled(bool shouldUseVoiceBank)
+    {
+        const ScopedLock sl(lock);
+
+        if (useVoiceBank == shouldUseVoiceBank)
+            return;
+
+        allNotesOff(0, false);
+        useVoiceBank = shouldUseVoiceBank;
+
+        for (auto* voice : voices)
+            static_cast<SineWaveVoice*>(voice)->setVoiceBank(useVoiceBank ? &bank : nullptr);
+    }
+
+    bool isVoiceBankEnabled() const noexcept
+    {
+        return useVoiceBank;
+    }
+
+    // True while any voice is playing or tailing off. Like getNumActiveVoices(), this is for the
+    // audio thread, which is the only one that changes the voices, so it doesn't take the lock.
+    bool isPlaying() const noexcept
+    {
+        return pool.hasActiveVoices();
+    }
+
+    // Sets how many worker threads help the audio thread render the voice bank. 0 renders
+    // everything on the audio thread. This starts or stops threads, so call it from the message
+    // thread.
+    void setNumRenderThreads(int numThreads)
+    {
+        const ScopedLock sl(lock);
+        renderWorkers.setNumWorkers(numThreads);
+    }
+
+    int getNumRenderThreads() const noexcept
+    {
+        return renderWorkers.getNumWorkers();
+    }
+
+    // Times the voice rendering as the StageTimings::voices stage. Call before playing.
+    void setStageTimings(StageTimings* newTimings) noexcept
+    {
+        stageTimings = newTimings;
+    }
+
+    // Limits how many notes can be held at once to a proportion of the voices, for the
+    // QualityGovernor. 1 removes the limit. It never waits, so it can be called from any thread,
+    // and takes effect the next time the synth renders: the quietest held notes over the limit
+    // are released and fade out over the usual tail-off of about 10 ms. From then on a note-on at
+    // the limit takes over the quietest held voice, the way a stolen voice is taken over.
+    void setVoiceLimit(float proportionOfVoices) noexcept
+    {
+        voiceLimit.store(jlimit(0.0f, 1.0f, proportionOfVoices), std::memory_order_relaxed);
+    }
+
+    int getVoiceLimit() const noexcept
+    {
+        return jmax(1, roundToInt(voiceLimit.load(std::memory_order_relaxed) * (float)voices.size()));
+    }
+
+    bool isVoiceLimited() const noexcept
+    {
+        return getVoiceLimit() < voices.size();
+    }
+
+    // For the audio thread, as the voices only change there
+    int getNumActiveVoices() const noexcept
+    {
+        return pool.getNumActiveVoices();
+    }
+
+    // How many notes have taken over a voice that was still sounding, since the synth was created
+    int64 getNumVoiceSteals() const noexcept
+    {
+        return numVoiceSteals;
+    }
+
+protected:
+    void renderVoices(AudioBuffer<float>& outputAudio, int startSample, int numSamples) override
+    {
+        // Synthesiser::processNextBlock() splits the block at every MIDI event and calls this for
+        // each part, so the trace shows how finely the MIDI cuts up the block
+        const StageTimings::ScopedStage stage(stageTimings, StageTimings::voices);
+        const TraceRecorder::ScopedEvent trace("Sub-block", "samples", numSamples);
+
+        // Called with the lock held, so this is where a lowered voice limit is applied
+        if (isVoiceLimited())
+            releaseQuietestVoices(getVoiceLimit());
+
+        if (useVoiceBank)
+            renderVoiceBank(outputAudio, startSample, numSamples);
+        else
+            renderEachVoice(outputAudio, startSample, numSamples);
+    }
+
+    void renderVoiceBank(AudioBuffer<float>& outputAudio, int startSample, int numSamples)
+    {
+        auto* mono = bankOutput.getWritePointer(0);
+
+        while (numSamples > 0)
+        {
+            auto numThisTime = jmin(numSamples, maximumBlockSize);
+
+            if (renderWorkers.getNumWorkers() > 0 ? renderSubMixes(mono, numThisTime)
+                                                  : bank.render(mono, numThisTime))
+            {
+                for (auto i = outputAudio.getNumChannels(); --i >= 0;)
+                    FloatVectorOperations::copy(outputAudio.getWritePointer(i, startSample), mono, numThisTime);
             }
             else
             {
-                while(--numSamples >= 0)
-                {
-                    auto currentSample =(float)(std::sin(currentAngle) * level);
+                outputAudio.clear(startSample, numThisTime);
+            }
+
+            startSample += numThisTime;
+            numSamples  -= numThisTime;
+        }
+
+        // Only voices that are tailing off can have gone silent
+        for (auto index = pool.getFirstReleased(); index >= 0;)
+        {
+            const auto next = pool.getNext(index);
+            static_cast<SineWaveVoice*>(voices.getUnchecked(index))->finishNoteIfSilent();
+            index = next;
+        }
+    }
+
+    // Returns the held voice playing the quietest note, or -1 if none is held. Among equally loud
+    // notes the oldest is picked.
+    int getQuietestHeldVoice() const noexcept
+    {
+        auto quietest = pool.getFirstHeld();
+
+        if (quietest >= 0)
+            for (auto index = pool.getNext(quietest); index >= 0; index = pool.getNext(index))
+                if (getSineVoice(index)->getLevel() < getSineVoice(quietest)->getLevel())
+                    quietest = index;
+
+        return quietest;
+    }
+
+    // Releases the quietest held notes until no more than maxHeld are left, counting each one as
+    // stolen
+    void releaseQuietestVoices(int maxHeld)
+    {
+        while (pool.getNumHeldVoices() > jmax(0, maxHeld))
+        {
+            const auto quietest = getQuietestHeldVoice();
+
+            ++numVoiceSteals;
+            TraceRecorder::instant("Voice stolen", "voice", quietest);
+            stopVoice(voices.getUnchecked(quietest), 0.0f, true);
+        }
+    }
+
+    SineWaveVoice* getSineVoice(int index) const noexcept
+    {
+        return static_cast<SineWaveVoice*>(voices.getUnchecked(index));
+    }
+
+    // Renders every group of the bank into its own sub-mix using the worker threads, then adds
+    // the sub-mixes to the mono buffer in group order. Returns false if every group was silent.
+    bool renderSubMixes(float* mono, int numSamples) noexcept
+    {
+        numSubMixSamples = numSamples;
+        renderWorkers.run(*this, bank.getNumGroups());
+
+        auto anyGroupActive = false;
+
+        for (auto group = 0; group < bank.getNumGroups(); ++group)
+        {
+            if (! groupIsActive[group])
+                continue;
+
+            if (! anyGroupActive)
+            {
+                FloatVectorOperations::clear(mono, numSamples);
+                anyGroupActive = true;
+            }
+
+            FloatVectorOperations::add(mono, subMixes + group * subMixStride, numSamples);
+        }
+
+        return anyGroupActive;
+    }
+
+    void renderItem(int group) noexcept override
+    {
+        groupIsActive[group] = ! bank.isGroupSilent(group);
+
+        if (groupIsActive[group])
+        {
+            auto* subMix = subMixes + group * subMixStride;
+
+            FloatVectorOperations::clear(subMix, numSubMixSamples);
+            bank.renderGroup(group, subMix, numSubMixSamples);
+        }
+    }
 
-                    for (auto i = outputBuffer.getNumChannels(); --i >= 0;)
-                        outputBuffer.addSample(i, startSample, currentSample);
+    void renderEachVoice(AudioBuffer<float>& outputAudio, int startSample, int numSamples)
+    {
+        while (numSamples > 0)
+        {
+            auto numThisTime = jmin(numSamples, maximumBlockSize);
+            auto outputIsCleared = false;
 
-                    currentAngle += angleDelta;
-                    ++startSample;
+            for (auto* v : voices)
+            {
+                auto* voice = static_cast<SineWaveVoice*>(v);
+
+                if (! voice->isVoiceActive())
+                    continue;
+
+                auto* voiceSamples = voice->renderVoiceBlock(numThisTime);
+
+                for (auto i = outputAudio.getNumChannels(); --i >= 0;)
+                {
+                    auto* out = outputAudio.getWritePointer(i, startSample);
+
+                    if (outputIsCleared)
+                        FloatVectorOperations::add(out, voiceSamples, numThisTime);
+                    else
+                        FloatVectorOperations::copy(out, voiceSamples, numThisTime);
                 }
+
+                outputIsCleared = true;
             }
+
+            if (! outputIsCleared)
+                outputAudio.clear(startSample, numThisTime);
+
+            startSample += numThisTime;
+            numSamples  -= numThisTime;
         }
     }
 
 private:
-    double currentAngle = 0.0, angleDelta = 0.0, level = 0.0, tailOff = 0.0;
+    const SineTable& sineTable;
+
+    VoicePool pool;
+    SineVoiceBank bank;
+    AudioBuffer<float> bankOutput;
+    bool useVoiceBank = true;
+
+    static constexpr int floatsPerCacheLine = 16;
+
+    HeapBlock<float> subMixStorage;
+    float* subMixes = nullptr;
+    HeapBlock<bool> groupIsActive;
+    int subMixStride = 0, numSubMixSamples = 0;
+
+    int maximumBlockSize = 512;
+
+    StageTimings* stageTimings = nullptr;
+    int64 numVoiceSteals = 0;
+    std::atomic<float> voiceLimit { 1.0f };
+
+    // Declared last so the threads are stopped before anything they might touch is destroyed
+    RenderWorkerPool renderWorkers;
 };
 
 struct SynthAudioSource : public AudioSource
 {
-    SynthAudioSource(MidiKeyboardState& keyState) : keyboardState(keyState)
+    SynthAudioSource(MidiKeyboardState& keyState) : keyboardState(keyState), synth(sineTable)
     {
-        for (auto i = 0; i < 4; ++i)
-            synth.addVoice(new SineWaveVoice());
-
         synth.addSound(new SineWaveSound());
+
+        // The keyboard's notes reach the audio thread through the lock-free queue, so the audio
+        // thread never has to take the keyboard state's lock
+        keyboardState.addListener(&midiQueue);
+    }
+
+    ~SynthAudioSource()
+    {
+        keyboardState.removeListener(&midiQueue);
     }
 
     void setUsingSineWaveSound()
@@ -109,34 +614,77 @@ struct SynthAudioSource : public AudioSource
         synth.clearSounds();
     }
 
-    void prepareToPlay(int /*samplesPerBlockExpected*/, double sampleRate) override
+    // Sets the number of voices, up to SineWaveSynth::maxPolyphony. Cuts any sounding notes.
+    void setPolyphony(int numVoices)
     {
+        synth.setPolyphony(numVoices);
+    }
+
+    // Sets the number of threads that help render the voices, see SineWaveSynth
+    void setNumRenderThreads(int numThreads)
+    {
+        synth.setNumRenderThreads(numThreads);
+    }
+
+    // Sets the size of the sine table shared by all voices as a power of two. Larger tables are
+    // more accurate but use more cache, see SineTable.h. Takes effect on the next prepareToPlay().
+    void setSineTableSize(int sizeLog2)
+    {
+        sineTableSizeLog2 = jlimit(SineTable::minSizeLog2, SineTable::maxSizeLog2, sizeLog2);
+    }
+
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override
+    {
+        if (sineTable.getSize() != (1 << sineTableSizeLog2))
+            sineTable.initialise(sineTableSizeLog2);
+
         synth.setCurrentPlaybackSampleRate(sampleRate);
-        midiCollector.reset(sampleRate);
+        synth.prepare(samplesPerBlockExpected);
+        midiQueue.reset(sampleRate);
+
+        // Reserve room up front so merging MIDI never has to grow the buffer on the audio thread.
+        // Each short message takes 9 bytes (a timestamp, a size and 3 bytes of data).
+        incomingMidi.ensureSize(maxMidiEventsPerBlock * 9);
     }
 
     void releaseResources() override {}
 
     void getNextAudioBlock(const AudioSourceChannelInfo& bufferToFill) override
     {
-        bufferToFill.clearActiveBufferRegion();
-
-        MidiBuffer incomingMidi;
-        midiCollector.removeNextBlockOfMessages(incomingMidi, bufferToFill.numSamples);
+        renderNextBlock(*bufferToFill.buffer, MidiBuffer(),
+                        bufferToFill.startSample, bufferToFill.numSamples);
+    }
 
-        keyboardState.processNextMidiBuffer(incomingMidi, bufferToFill.startSample,
-                                             bufferToFill.numSamples, true);
+    // Renders the synth, playing the host's MIDI for this block together with anything coming
+    // from MIDI inputs and the on-screen keyboard. hostMidi is positioned relative to startSample,
+    // as in AudioProcessor::processBlock().
+    void renderNextBlock(AudioBuffer<float>& buffer, const MidiBuffer& hostMidi,
+                         int startSample, int numSamples)
+    {
+        // Everything is merged into one buffer that is reused from block to block. MidiBuffer
+        // keeps events sorted by time, so the result stays sample accurate.
+        incomingMidi.clear();
+        midiQueue.readNextBlock(incomingMidi, numSamples);
+        incomingMidi.addEvents(hostMidi, 0, numSamples, 0);
 
-        synth.renderNextBlock(*bufferToFill.buffer, incomingMidi,
-                               bufferToFill.startSample, bufferToFill.numSamples);
+        // No need to clear the buffer first: SineWaveSynth writes every sample it is asked to
+        // render, either by copying the first active voice or by clearing it when all are silent.
+        synth.renderNextBlock(buffer, incomingMidi, startSample, numSamples);
     }
 
-    MidiMessageCollector* getMidiCollector()
+    // Register this with a MidiInput to play it through the synth
+    MidiInputCallback* getMidiInputCallback()
     {
-        return &midiCollector;
+        return &midiQueue;
     }
 
+    SineTable sineTable;
+    int sineTableSizeLog2 = SineTable::defaultSizeLog2;
+
     MidiKeyboardState& keyboardState;
-    Synthesiser synth;
-    MidiMessageCollector midiCollector;
+    SineWaveSynth synth;
+    MidiEventQueue midiQueue;
+
+    static constexpr int maxMidiEventsPerBlock = 1024;
+    MidiBuffer incomingMidi;
 };
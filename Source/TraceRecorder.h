@@ -0,0 +1,236 @@
+#pragma once
+
+#include <chrono>
+
+// Builds with BASICSYNTH_TRACE=1 record a timeline of the audio thread, see TraceRecorder. It is
+// off by default, and then every call below compiles to nothing.
+#ifndef BASICSYNTH_TRACE
+ #define BASICSYNTH_TRACE 0
+#endif
+
+// Records begin and end events from the audio thread and writes them to a trace file that
+// chrome://tracing or ui.perfetto.dev can open.
+//
+// Each BasicSynth holds one through a SharedResourcePointer, so all the instances in a process
+// share a recorder, which lives for as long as any of them. It writes to a new file in
+// "BasicSynth Traces" in the user's documents folder.
+//
+// Events go into a fixed ring buffer that is allocated up front. Recording one is a
+// compare-and-swap on the write position and a few stores, so several threads can record at once
+// and none of them ever waits for the others or for the file. The writer thread empties the ring
+// every flushIntervalMs. If it falls a whole ring behind, new events are dropped and counted
+// rather than blocking the audio thread, and the trace shows how many were lost.
+//
+// Names must be string literals, or anything else that lives until the recorder is destroyed, as
+// only the pointer is kept.
+struct TraceRecorder : private Thread
+{
+    // Records a begin event now and the matching end event when it goes out of scope, with an
+    // optional value shown in the event's arguments
+    struct ScopedEvent
+    {
+        ScopedEvent(const char* n, const char* argumentName = nullptr, int value = 0) noexcept
+           #if BASICSYNTH_TRACE
+            : name(n)
+           #endif
+        {
+            record('B', n, argumentName, value);
+        }
+
+        ~ScopedEvent() noexcept
+        {
+           #if BASICSYNTH_TRACE
+            record('E', name, nullptr, 0);
+           #endif
+        }
+
+    private:
+       #if BASICSYNTH_TRACE
+        const char* const name;
+       #endif
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedEvent)
+    };
+
+    // Records an event with no duration, like a note-on
+    static void instant(const char* name, const char* argumentName = nullptr, int value = 0) noexcept
+    {
+        record('i', name, argumentName, value);
+    }
+
+    static void record(char phase, const char* name, const char* argumentName, int value) noexcept
+    {
+       #if BASICSYNTH_TRACE
+        if (auto* recorder = getCurrent().load(std::memory_order_acquire))
+            recorder->push(phase, name, argumentName, value);
+       #else
+        ignoreUnused(phase, name, argumentName, value);
+       #endif
+    }
+
+    static constexpr int ringSizeLog2 = 16;
+    static constexpr int flushIntervalMs = 50;
+
+    TraceRecorder() : Thread("Trace writer")
+    {
+        events.calloc((size_t)ringSize);
+
+        for (auto i = 0; i < ringSize; ++i)
+            events[i].sequence.store((uint64)i, std::memory_order_relaxed);
+
+        const auto folder = File::getSpecialLocation(File::userDocumentsDirectory).getChildFile("BasicSynth Traces");
+        folder.createDirectory();
+
+        file = folder.getChildFile("Trace " + Time::getCurrentTime().formatted("%Y-%m-%d %H-%M-%S") + ".json")
+                     .getNonexistentSibling();
+        stream = file.createOutputStream();
+
+        if (stream != nullptr)
+            *stream << "{\"traceEvents\":[\n"
+                    << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"BasicSynth\"}}";
+
+        startTime = now();
+        getCurrent().store(this, std::memory_order_release);
+        startThread();
+    }
+
+    ~TraceRecorder()
+    {
+        getCurrent().store(nullptr, std::memory_order_release);
+
+        stopThread(-1);
+        writeEvents();
+
+        if (stream != nullptr)
+            *stream << "\n]}\n";
+    }
+
+    File getFile() const
+    {
+        return file;
+    }
+
+private:
+    static constexpr int ringSize = 1 << ringSizeLog2;
+
+    struct Event
+    {
+        // The slot is free for the writer at write position n when this is n, and holds that
+        // write's event once it is n + 1
+        std::atomic<uint64> sequence;
+
+        int64 time;
+        const char* name;
+        const char* argumentName;
+        int value;
+        uint32 threadId;
+        char phase;
+    };
+
+    static std::atomic<TraceRecorder*>& getCurrent() noexcept
+    {
+        static std::atomic<TraceRecorder*> current { nullptr };
+        return current;
+    }
+
+    static int64 now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void push(char phase, const char* name, const char* argumentName, int value) noexcept
+    {
+        auto position = writePosition.load(std::memory_order_relaxed);
+        Event* event = nullptr;
+
+        for (;;)
+        {
+            event = events + (position & (ringSize - 1));
+            const auto sequence = event->sequence.load(std::memory_order_acquire);
+
+            if (sequence == position)
+            {
+                if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (sequence < position)
+            {
+                // The writer thread hasn't got to this slot yet
+                numDropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            else
+            {
+                position = writePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        event->time = now();
+        event->name = name;
+        event->argumentName = argumentName;
+        event->value = value;
+        event->threadId = (uint32)(pointer_sized_int)Thread::getCurrentThreadId();
+        event->phase = phase;
+        event->sequence.store(position + 1, std::memory_order_release);
+    }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            writeEvents();
+            wait(flushIntervalMs);
+        }
+    }
+
+    // Called by the writer thread, and by the destructor once it has stopped
+    void writeEvents()
+    {
+        if (stream == nullptr)
+            return;
+
+        for (;;)
+        {
+            auto& event = events[readPosition & (ringSize - 1)];
+
+            if (event.sequence.load(std::memory_order_acquire) != readPosition + 1)
+                break;
+
+            // Chrome wants microseconds, and keeps the fraction
+            *stream << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"" << String::charToString(event.phase)
+                    << "\",\"ts\":" << String((double)(event.time - startTime) / 1000.0, 3)
+                    << ",\"pid\":1,\"tid\":" << String(event.threadId);
+
+            if (event.phase == 'i')
+                *stream << ",\"s\":\"t\"";
+
+            if (event.argumentName != nullptr)
+                *stream << ",\"args\":{\"" << event.argumentName << "\":" << event.value << "}";
+
+            *stream << "}";
+
+            event.sequence.store(readPosition + ringSize, std::memory_order_release);
+            ++readPosition;
+        }
+
+        const auto dropped = numDropped.exchange(0, std::memory_order_relaxed);
+
+        if (dropped > 0)
+            *stream << ",\n{\"name\":\"Dropped events\",\"ph\":\"i\",\"s\":\"g\",\"ts\":"
+                    << String((double)(now() - startTime) / 1000.0, 3)
+                    << ",\"pid\":1,\"tid\":0,\"args\":{\"count\":" << dropped << "}}";
+
+        stream->flush();
+    }
+
+    HeapBlock<Event> events;
+    std::atomic<uint64> writePosition { 0 };
+    uint64 readPosition = 0;
+    std::atomic<int64> numDropped { 0 };
+
+    File file;
+    ScopedPointer<FileOutputStream> stream;
+    int64 startTime = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(TraceRecorder)
+};
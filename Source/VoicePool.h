@@ -0,0 +1,212 @@
+#pragma once
+
+// Bookkeeping for a fixed pool of voices, so that the cost of a note-on or note-off doesn't grow
+// with the polyphony.
+//
+// Every voice is in exactly one of three intrusive, doubly linked lists: free, held (key or pedal
+// still down) or released (tailing off). The held and released lists are kept in the order the
+// notes started, so the oldest voice of either kind is always at the head. A table indexed by
+// MIDI channel and note number points at the voice most recently started for that key.
+//
+// Everything is allocated up front by prepare(), nothing allocates afterwards.
+struct VoicePool
+{
+    void prepare(int numVoices)
+    {
+        numVoices = jmax(0, numVoices);
+
+        // The three list heads live after the voices, at numVoices + listIndex
+        links.malloc((size_t)(numVoices + numLists));
+        voiceState.malloc((size_t)numVoices);
+        voiceKey.malloc((size_t)numVoices);
+        voiceForKey.malloc((size_t)numKeys);
+
+        for (auto list = 0; list < numLists; ++list)
+        {
+            auto& head = links[numVoices + list];
+            head.next = head.previous = numVoices + list;
+        }
+
+        size = numVoices;
+
+        listSize[freeList] = numVoices;
+        listSize[heldList] = listSize[releasedList] = 0;
+
+        for (auto i = 0; i < numVoices; ++i)
+        {
+            voiceState[i] = freeList;
+            voiceKey[i] = -1;
+            append(i, freeList);
+        }
+
+        for (auto i = 0; i < numKeys; ++i)
+            voiceForKey[i] = -1;
+    }
+
+    int getNumVoices() const noexcept
+    {
+        return size;
+    }
+
+    // Returns the free voice that has been idle the longest, or -1 if every voice is in use
+    int getFreeVoice() const noexcept
+    {
+        return getFirst(freeList);
+    }
+
+    // Returns the oldest voice that is tailing off, or failing that the oldest held voice
+    int getVoiceToSteal() const noexcept
+    {
+        auto voice = getFirst(releasedList);
+        return voice >= 0 ? voice : getFirst(heldList);
+    }
+
+    // Returns the voice last started for this channel and note, or -1
+    int getVoiceForNote(int midiChannel, int midiNoteNumber) const noexcept
+    {
+        return voiceForKey[getKey(midiChannel, midiNoteNumber)];
+    }
+
+    void noteStarted(int voice, int midiChannel, int midiNoteNumber) noexcept
+    {
+        forgetKey(voice);
+
+        const auto key = getKey(midiChannel, midiNoteNumber);
+        voiceForKey[key] = voice;
+        voiceKey[voice] = key;
+
+        moveTo(voice, heldList);
+    }
+
+    void noteReleased(int voice) noexcept
+    {
+        if (voiceState[voice] == heldList)
+            moveTo(voice, releasedList);
+    }
+
+    void noteFinished(int voice) noexcept
+    {
+        forgetKey(voice);
+        moveTo(voice, freeList);
+    }
+
+    // True if any voice is held or tailing off
+    bool hasActiveVoices() const noexcept
+    {
+        return getFirst(heldList) >= 0 || getFirst(releasedList) >= 0;
+    }
+
+    // The number of voices held or tailing off
+    int getNumActiveVoices() const noexcept
+    {
+        return size - listSize[freeList];
+    }
+
+    // The number of voices whose key or pedal is still down
+    int getNumHeldVoices() const noexcept
+    {
+        return listSize[heldList];
+    }
+
+    bool isHeld(int voice) const noexcept
+    {
+        return voiceState[voice] == heldList;
+    }
+
+    bool isReleased(int voice) const noexcept
+    {
+        return voiceState[voice] == releasedList;
+    }
+
+    // Iterate the held or tailing off voices, oldest first, by following getNext() from these.
+    // It is safe to move the current voice to another list as long as the next one was fetched
+    // beforehand.
+    int getFirstHeld() const noexcept
+    {
+        return getFirst(heldList);
+    }
+
+    int getFirstReleased() const noexcept
+    {
+        return getFirst(releasedList);
+    }
+
+    // The voice after this one in the same list, or -1 at the end
+    int getNext(int voice) const noexcept
+    {
+        const auto next = links[voice].next;
+        return next < size ? next : -1;
+    }
+
+private:
+    enum
+    {
+        freeList,
+        heldList,
+        releasedList,
+        numLists
+    };
+
+    static constexpr int numKeys = 16 * 128;
+
+    struct Link
+    {
+        int previous, next;
+    };
+
+    static int getKey(int midiChannel, int midiNoteNumber) noexcept
+    {
+        jassert(midiChannel >= 1 && midiChannel <= 16 && isPositiveAndBelow(midiNoteNumber, 128));
+        return ((midiChannel - 1) & 15) * 128 + (midiNoteNumber & 127);
+    }
+
+    int getFirst(int list) const noexcept
+    {
+        const auto first = links[size + list].next;
+        return first < size ? first : -1;
+    }
+
+    void forgetKey(int voice) noexcept
+    {
+        const auto key = voiceKey[voice];
+
+        if (key >= 0 && voiceForKey[key] == voice)
+            voiceForKey[key] = -1;
+
+        voiceKey[voice] = -1;
+    }
+
+    void append(int voice, int list) noexcept
+    {
+        auto& head = links[size + list];
+        auto& link = links[voice];
+
+        link.previous = head.previous;
+        link.next = size + list;
+        links[head.previous].next = voice;
+        head.previous = voice;
+    }
+
+    void unlink(int voice) noexcept
+    {
+        auto& link = links[voice];
+
+        links[link.previous].next = link.next;
+        links[link.next].previous = link.previous;
+    }
+
+    void moveTo(int voice, int list) noexcept
+    {
+        --listSize[voiceState[voice]];
+        ++listSize[list];
+
+        unlink(voice);
+        append(voice, list);
+        voiceState[voice] = list;
+    }
+
+    HeapBlock<Link> links;
+    HeapBlock<int> voiceState, voiceKey, voiceForKey;
+    int size = 0;
+    int listSize[numLists] = {};
+};
@@ -0,0 +1,234 @@
+#pragma once
+
+// Measures every processBlock() against its real-time budget, numSamples / sampleRate, to find
+// the blocks that could have made the host drop out (an xrun) and what was going on at the time.
+//
+// Each block's load, its time divided by its budget, goes into a histogram with four buckets per
+// octave, from 1/256 of the budget up to 8 times it. The worst blocks are kept as well, with the
+// number of voices playing, the MIDI events and the parameter changes in the block, so a crackle
+// can be matched up with what caused it. A block over its budget is counted as late, though a
+// host with more buffering may still have got away with it.
+//
+// The audio thread only ever writes, with relaxed stores to atomics for the histogram and a
+// sequence lock around the worst blocks, so it never waits. Readers copy the worst blocks again
+// if the audio thread changed them part way through. Nothing is reset by prepareToPlay(), so a
+// report covers the whole session.
+struct XrunDetector
+{
+    static constexpr int bucketsPerOctave = 4;
+    static constexpr int lowestOctave = -8, highestOctave = 3;
+    static constexpr int numBuckets = (highestOctave - lowestOctave) * bucketsPerOctave + 2;
+    static constexpr int maxWorstBlocks = 32;
+
+    // What was going on in a block
+    struct Block
+    {
+        double seconds = 0.0;       // since the detector was created, in audio time
+        int numSamples = 0;
+        double milliseconds = 0.0;
+        double budgetMilliseconds = 0.0;
+        float load = 0.0f;
+        int numActiveVoices = 0;
+        int numMidiEvents = 0;
+        int numParameterChanges = 0;
+
+        var toVar() const
+        {
+            auto* object = new DynamicObject();
+
+            object->setProperty("seconds", seconds);
+            object->setProperty("samples", numSamples);
+            object->setProperty("ms", milliseconds);
+            object->setProperty("budgetMs", budgetMilliseconds);
+            object->setProperty("load", load);
+            object->setProperty("activeVoices", numActiveVoices);
+            object->setProperty("midiEvents", numMidiEvents);
+            object->setProperty("parameterChanges", numParameterChanges);
+
+            return var(object);
+        }
+    };
+
+    // Returns the bucket a load falls in. Bucket 0 holds everything below the lowest octave and
+    // the last bucket everything above the highest.
+    static int getBucket(float load) noexcept
+    {
+        if (load <= 0.0f)
+            return 0;
+
+        const auto position = std::log2(load) - (float)lowestOctave;
+        return jlimit(0, numBuckets - 1, 1 + (int)std::floor(position * (float)bucketsPerOctave));
+    }
+
+    // The lowest load in a bucket
+    static float getBucketStart(int bucket) noexcept
+    {
+        return bucket <= 0 ? 0.0f : std::exp2((float)lowestOctave + (float)(bucket - 1) / (float)bucketsPerOctave);
+    }
+
+    void prepare(double newSampleRate) noexcept
+    {
+        sampleRate = newSampleRate;
+    }
+
+    // Call from the audio thread at the end of every block
+    void addBlock(int64 nanoseconds, int numSamples, int numActiveVoices, int numMidiEvents,
+                  int numParameterChanges) noexcept
+    {
+        if (sampleRate <= 0.0 || numSamples <= 0)
+            return;
+
+        Block block;
+        block.seconds = audioSeconds;
+        block.numSamples = numSamples;
+        block.milliseconds = (double)nanoseconds * 1.0e-6;
+        block.budgetMilliseconds = 1000.0 * numSamples / sampleRate;
+        block.load = (float)(block.milliseconds / block.budgetMilliseconds);
+        block.numActiveVoices = numActiveVoices;
+        block.numMidiEvents = numMidiEvents;
+        block.numParameterChanges = numParameterChanges;
+
+        audioSeconds += numSamples / sampleRate;
+
+        increment(histogram[getBucket(block.load)]);
+        increment(numBlocks);
+
+        if (block.load > 1.0f)
+            increment(numLateBlocks);
+
+        addToWorstBlocks(block);
+    }
+
+    // The rest can be called from any thread
+
+    int64 getNumBlocks() const noexcept
+    {
+        return numBlocks.load(std::memory_order_relaxed);
+    }
+
+    int64 getNumLateBlocks() const noexcept
+    {
+        return numLateBlocks.load(std::memory_order_relaxed);
+    }
+
+    // The worst blocks so far, worst first
+    Array<Block> getWorstBlocks() const
+    {
+        Array<Block> blocks;
+
+        for (;;)
+        {
+            const auto version = worstBlocksVersion.load(std::memory_order_acquire);
+
+            if ((version & 1) != 0)
+            {
+                Thread::yield();
+                continue;
+            }
+
+            blocks.clearQuick();
+
+            for (auto i = 0; i < numWorstBlocks.load(std::memory_order_relaxed); ++i)
+                blocks.add(worstBlocks[i]);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (worstBlocksVersion.load(std::memory_order_relaxed) == version)
+                break;
+        }
+
+        struct WorstFirst
+        {
+            static int compareElements(const Block& a, const Block& b) noexcept
+            {
+                return a.load > b.load ? -1 : (a.load < b.load ? 1 : 0);
+            }
+        };
+
+        WorstFirst comparator;
+        blocks.sort(comparator);
+        return blocks;
+    }
+
+    // Everything as one object, for writing out as JSON
+    var toVar() const
+    {
+        Array<var> buckets;
+
+        for (auto i = 0; i < numBuckets; ++i)
+        {
+            const auto count = histogram[i].load(std::memory_order_relaxed);
+
+            if (count == 0)
+                continue;
+
+            auto* bucket = new DynamicObject();
+            bucket->setProperty("loadFrom", getBucketStart(i));
+            bucket->setProperty("loadTo", i == numBuckets - 1 ? var() : var(getBucketStart(i + 1)));
+            bucket->setProperty("blocks", count);
+            buckets.add(var(bucket));
+        }
+
+        Array<var> worst;
+
+        for (auto& block : getWorstBlocks())
+            worst.add(block.toVar());
+
+        auto* object = new DynamicObject();
+        object->setProperty("date", Time::getCurrentTime().toISO8601(true));
+        object->setProperty("cpu", SystemStats::getCpuModel());
+        object->setProperty("blocks", getNumBlocks());
+        object->setProperty("lateBlocks", getNumLateBlocks());
+        object->setProperty("histogram", buckets);
+        object->setProperty("worstBlocks", worst);
+
+        return var(object);
+    }
+
+private:
+    static void increment(std::atomic<int64>& counter) noexcept
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void addToWorstBlocks(const Block& block) noexcept
+    {
+        const auto count = numWorstBlocks.load(std::memory_order_relaxed);
+        auto slot = count;
+
+        // Once full, a block only goes in if it is worse than the best of the worst, which soon
+        // becomes rare
+        if (count == maxWorstBlocks)
+        {
+            slot = 0;
+
+            for (auto i = 1; i < count; ++i)
+                if (worstBlocks[i].load < worstBlocks[slot].load)
+                    slot = i;
+
+            if (block.load <= worstBlocks[slot].load)
+                return;
+        }
+
+        const auto version = worstBlocksVersion.load(std::memory_order_relaxed);
+        worstBlocksVersion.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        worstBlocks[slot] = block;
+        numWorstBlocks.store(jmax(count, slot + 1), std::memory_order_relaxed);
+
+        worstBlocksVersion.store(version + 2, std::memory_order_release);
+    }
+
+    // Only touched by the audio thread
+    double sampleRate = 0.0;
+    double audioSeconds = 0.0;
+
+    std::atomic<int64> histogram[numBuckets] {};
+    std::atomic<int64> numBlocks { 0 }, numLateBlocks { 0 };
+
+    // Odd while the audio thread is changing the worst blocks
+    std::atomic<uint32> worstBlocksVersion { 0 };
+    std::atomic<int> numWorstBlocks { 0 };
+    Block worstBlocks[maxWorstBlocks];
+};